@@ -0,0 +1,10 @@
+/***************************************************
+  Font data for DirectCanvas (see DirectCanvas.h).
+
+  License: Apache 2.0 or MIT, at your choice.
+ ****************************************************/
+
+#include "DirectCanvas.h"
+#include <glcdfont.c>
+
+const unsigned char * const DirectCanvas_font = font;
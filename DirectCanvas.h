@@ -0,0 +1,380 @@
+#ifndef DirectCanvas_h
+#define DirectCanvas_h
+
+// Drawing on a DirectMatrix without virtual calls.
+//
+// Adafruit_GFX draws everything with the virtual drawPixel(), so the
+// compiler can't inline the bounds and rotation checks into a line or a
+// character and pays a call per pixel. DirectGFX has the same primitives
+// and method names (lines, rects, circles, bitmaps, classic 5x7 text
+// through Print) and the same algorithms, so it draws the same pixels, but
+// it is a template on the canvas class (CRTP): pixel and span writes are
+// resolved at compile time and inlined.
+//
+// DirectCanvas is a DirectMatrix with DirectGFX on top, use it instead of
+// PWMDirectMatrix:
+//   DirectCanvas *matrix = new DirectCanvas(8, 8, 3);
+//   matrix->begin(rowPins, colPins, srPins, 200);
+//   matrix->drawLine(0, 0, 7, 7, LED_RED_HIGH);
+//   matrix->writeDisplay();
+// Code that takes an Adafruit_GFX & (GFX fonts, other libraries) still needs
+// a PWMDirectMatrix, both can share the same panel size and rotation.
+// extras/bench/bench_canvas compares the two.
+
+#include "LED_Matrix.h"
+
+// Adafruit_GFX's font (in PROGMEM), so that text looks the same. glcdfont.c
+// defines it static, DirectCanvas.cpp includes it once and points to it.
+extern const unsigned char * const DirectCanvas_font;
+
+// Canvas provides drawPixel() (rotated coordinates, any value), and may
+// provide faster drawFastHLine(), drawFastVLine(), fillRect() and
+// fillScreen() than the ones built on drawPixel() below.
+template <class Canvas>
+class DirectGFX : public Print {
+ public:
+  DirectGFX(int16_t w, int16_t h) :
+    WIDTH(w), HEIGHT(h), _width(w), _height(h), rotation(0),
+    cursor_x(0), cursor_y(0), textcolor(0xFFFF), textbgcolor(0xFFFF),
+    textsize(1), wrap(true), _cp437(false) { }
+
+  // Adafruit_GFX has these for displays with transactions, they are the
+  // same as the draw* ones here.
+  void startWrite(void) { }
+  void endWrite(void) { }
+  void writePixel(int16_t x, int16_t y, uint16_t color) {
+    self().drawPixel(x, y, color);
+  }
+  void writeFastVLine(int16_t x, int16_t y, int16_t h, uint16_t color) {
+    self().drawFastVLine(x, y, h, color);
+  }
+  void writeFastHLine(int16_t x, int16_t y, int16_t w, uint16_t color) {
+    self().drawFastHLine(x, y, w, color);
+  }
+  void writeFillRect(int16_t x, int16_t y, int16_t w, int16_t h,
+		     uint16_t color) {
+    self().fillRect(x, y, w, h, color);
+  }
+
+  void drawFastVLine(int16_t x, int16_t y, int16_t h, uint16_t color) {
+    for (int16_t i = 0; i < h; i++) self().drawPixel(x, y + i, color);
+  }
+  void drawFastHLine(int16_t x, int16_t y, int16_t w, uint16_t color) {
+    for (int16_t i = 0; i < w; i++) self().drawPixel(x + i, y, color);
+  }
+  void fillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color) {
+    for (int16_t i = x; i < x + w; i++) self().drawFastVLine(i, y, h, color);
+  }
+  void fillScreen(uint16_t color) {
+    self().fillRect(0, 0, _width, _height, color);
+  }
+
+  void writeLine(int16_t x0, int16_t y0, int16_t x1, int16_t y1,
+		 uint16_t color) {
+    int16_t steep = abs(y1 - y0) > abs(x1 - x0);
+    int16_t t;
+
+    if (steep) {
+      t = x0; x0 = y0; y0 = t;
+      t = x1; x1 = y1; y1 = t;
+    }
+    if (x0 > x1) {
+      t = x0; x0 = x1; x1 = t;
+      t = y0; y0 = y1; y1 = t;
+    }
+
+    int16_t dx = x1 - x0;
+    int16_t dy = abs(y1 - y0);
+    int16_t err = dx / 2;
+    int16_t ystep = (y0 < y1) ? 1 : -1;
+
+    for (; x0 <= x1; x0++) {
+      if (steep) self().drawPixel(y0, x0, color);
+      else self().drawPixel(x0, y0, color);
+      err -= dy;
+      if (err < 0) {
+	y0 += ystep;
+	err += dx;
+      }
+    }
+  }
+  void drawLine(int16_t x0, int16_t y0, int16_t x1, int16_t y1,
+		uint16_t color) {
+    if (x0 == x1) {
+      if (y0 > y1) self().drawFastVLine(x0, y1, y0 - y1 + 1, color);
+      else self().drawFastVLine(x0, y0, y1 - y0 + 1, color);
+    } else if (y0 == y1) {
+      if (x0 > x1) self().drawFastHLine(x1, y0, x0 - x1 + 1, color);
+      else self().drawFastHLine(x0, y0, x1 - x0 + 1, color);
+    } else {
+      writeLine(x0, y0, x1, y1, color);
+    }
+  }
+  void drawRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color) {
+    self().drawFastHLine(x, y, w, color);
+    self().drawFastHLine(x, y + h - 1, w, color);
+    self().drawFastVLine(x, y, h, color);
+    self().drawFastVLine(x + w - 1, y, h, color);
+  }
+
+  void drawCircle(int16_t x0, int16_t y0, int16_t r, uint16_t color) {
+    int16_t f = 1 - r;
+    int16_t ddF_x = 1;
+    int16_t ddF_y = -2 * r;
+    int16_t x = 0;
+    int16_t y = r;
+
+    self().drawPixel(x0, y0 + r, color);
+    self().drawPixel(x0, y0 - r, color);
+    self().drawPixel(x0 + r, y0, color);
+    self().drawPixel(x0 - r, y0, color);
+    while (x < y) {
+      if (f >= 0) {
+	y--;
+	ddF_y += 2;
+	f += ddF_y;
+      }
+      x++;
+      ddF_x += 2;
+      f += ddF_x;
+      self().drawPixel(x0 + x, y0 + y, color);
+      self().drawPixel(x0 - x, y0 + y, color);
+      self().drawPixel(x0 + x, y0 - y, color);
+      self().drawPixel(x0 - x, y0 - y, color);
+      self().drawPixel(x0 + y, y0 + x, color);
+      self().drawPixel(x0 - y, y0 + x, color);
+      self().drawPixel(x0 + y, y0 - x, color);
+      self().drawPixel(x0 - y, y0 - x, color);
+    }
+  }
+  void fillCircle(int16_t x0, int16_t y0, int16_t r, uint16_t color) {
+    int16_t f = 1 - r;
+    int16_t ddF_x = 1;
+    int16_t ddF_y = -2 * r;
+    int16_t x = 0;
+    int16_t y = r;
+    int16_t px = x;
+    int16_t py = y;
+
+    self().drawFastVLine(x0, y0 - r, 2 * r + 1, color);
+    while (x < y) {
+      if (f >= 0) {
+	y--;
+	ddF_y += 2;
+	f += ddF_y;
+      }
+      x++;
+      ddF_x += 2;
+      f += ddF_x;
+      if (x < y + 1) {
+	self().drawFastVLine(x0 + x, y0 - y, 2 * y + 1, color);
+	self().drawFastVLine(x0 - x, y0 - y, 2 * y + 1, color);
+      }
+      if (y != py) {
+	self().drawFastVLine(x0 + py, y0 - px, 2 * px + 1, color);
+	self().drawFastVLine(x0 - py, y0 - px, 2 * px + 1, color);
+	py = y;
+      }
+      px = x;
+    }
+  }
+
+  // 1 bit per pixel, rows padded to a byte, MSB first, in PROGMEM
+  void drawBitmap(int16_t x, int16_t y, const uint8_t *bitmap, int16_t w,
+		  int16_t h, uint16_t color) {
+    int16_t byteWidth = (w + 7) / 8;
+    uint8_t byte = 0;
+
+    for (int16_t j = 0; j < h; j++, y++) {
+      for (int16_t i = 0; i < w; i++) {
+	if (i & 7) byte <<= 1;
+	else byte = pgm_read_byte(&bitmap[j * byteWidth + i / 8]);
+	if (byte & 0x80) self().drawPixel(x + i, y, color);
+      }
+    }
+  }
+  void drawBitmap(int16_t x, int16_t y, const uint8_t *bitmap, int16_t w,
+		  int16_t h, uint16_t color, uint16_t bg) {
+    int16_t byteWidth = (w + 7) / 8;
+    uint8_t byte = 0;
+
+    for (int16_t j = 0; j < h; j++, y++) {
+      for (int16_t i = 0; i < w; i++) {
+	if (i & 7) byte <<= 1;
+	else byte = pgm_read_byte(&bitmap[j * byteWidth + i / 8]);
+	self().drawPixel(x + i, y, (byte & 0x80) ? color : bg);
+      }
+    }
+  }
+  // One color per pixel, in PROGMEM or in RAM
+  void drawRGBBitmap(int16_t x, int16_t y, const uint16_t *bitmap, int16_t w,
+		     int16_t h) {
+    for (int16_t j = 0; j < h; j++, y++)
+      for (int16_t i = 0; i < w; i++)
+	self().drawPixel(x + i, y, pgm_read_word(&bitmap[j * w + i]));
+  }
+  void drawRGBBitmap(int16_t x, int16_t y, uint16_t *bitmap, int16_t w,
+		     int16_t h) {
+    for (int16_t j = 0; j < h; j++, y++)
+      for (int16_t i = 0; i < w; i++)
+	self().drawPixel(x + i, y, bitmap[j * w + i]);
+  }
+
+  void drawChar(int16_t x, int16_t y, unsigned char c, uint16_t color,
+		uint16_t bg, uint8_t size) {
+    if ((x >= _width) || (y >= _height) ||
+	((x + 6 * size - 1) < 0) || ((y + 8 * size - 1) < 0)) return;
+    // Adafruit_GFX skips a glyph there unless cp437(true), see cp437()
+    if (! _cp437 && (c >= 176)) c++;
+
+    for (int8_t i = 0; i < 5; i++) {
+      uint8_t line = pgm_read_byte(&DirectCanvas_font[c * 5 + i]);
+      for (int8_t j = 0; j < 8; j++, line >>= 1) {
+	if (line & 1) {
+	  if (size == 1) self().drawPixel(x + i, y + j, color);
+	  else self().fillRect(x + i * size, y + j * size, size, size, color);
+	} else if (bg != color) {
+	  if (size == 1) self().drawPixel(x + i, y + j, bg);
+	  else self().fillRect(x + i * size, y + j * size, size, size, bg);
+	}
+      }
+    }
+    if (bg != color) {
+      if (size == 1) self().drawFastVLine(x + 5, y, 8, bg);
+      else self().fillRect(x + 5 * size, y, size, 8 * size, bg);
+    }
+  }
+  size_t write(uint8_t c) {
+    if (c == '\n') {
+      cursor_x = 0;
+      cursor_y += textsize * 8;
+    } else if (c != '\r') {
+      if (wrap && ((cursor_x + textsize * 6) > _width)) {
+	cursor_x = 0;
+	cursor_y += textsize * 8;
+      }
+      drawChar(cursor_x, cursor_y, c, textcolor, textbgcolor, textsize);
+      cursor_x += textsize * 6;
+    }
+    return 1;
+  }
+  using Print::write;
+
+  void setCursor(int16_t x, int16_t y) { cursor_x = x; cursor_y = y; }
+  int16_t getCursorX(void) const { return cursor_x; }
+  int16_t getCursorY(void) const { return cursor_y; }
+  void setTextSize(uint8_t s) { textsize = (s > 0) ? s : 1; }
+  // Same color for the background is transparent
+  void setTextColor(uint16_t c) { textcolor = textbgcolor = c; }
+  void setTextColor(uint16_t c, uint16_t bg) { textcolor = c; textbgcolor = bg; }
+  void setTextWrap(boolean w) { wrap = w; }
+  void cp437(boolean x = true) { _cp437 = x; }
+
+  void setRotation(uint8_t r) {
+    rotation = r & 3;
+    _width = (rotation & 1) ? HEIGHT : WIDTH;
+    _height = (rotation & 1) ? WIDTH : HEIGHT;
+  }
+  uint8_t getRotation(void) const { return rotation; }
+  int16_t width(void) const { return _width; }
+  int16_t height(void) const { return _height; }
+
+ protected:
+  Canvas &self(void) { return *static_cast<Canvas *>(this); }
+
+  const int16_t WIDTH, HEIGHT;
+  int16_t _width, _height;
+  uint8_t rotation;
+  int16_t cursor_x, cursor_y;
+  uint16_t textcolor, textbgcolor;
+  uint8_t textsize;
+  boolean wrap;
+  boolean _cp437;
+};
+
+class DirectCanvas : public DirectMatrix, public DirectGFX<DirectCanvas> {
+ public:
+  // Same as PWMDirectMatrix: common is 0 for common cathode rows
+  DirectCanvas(uint8_t rows, uint8_t cols, uint8_t colors, uint8_t common = 0) :
+    DirectMatrix(rows, cols, colors, common),
+    DirectGFX<DirectCanvas>(cols, rows) { }
+
+  void drawPixel(int16_t x, int16_t y, uint16_t color) {
+    if ((uint16_t) x >= (uint16_t) _width) return;
+    if ((uint16_t) y >= (uint16_t) _height) return;
+    _matrix[pixelIndex(x, y, rotation)] = color;
+  }
+  uint16_t getPixel(int16_t x, int16_t y) {
+    if ((uint16_t) x >= (uint16_t) _width) return 0;
+    if ((uint16_t) y >= (uint16_t) _height) return 0;
+    return _matrix[pixelIndex(x, y, rotation)];
+  }
+
+  // Lines and rectangles are clipped once, then written along the
+  // framebuffer with the step of x or y for the rotation.
+  void drawFastHLine(int16_t x, int16_t y, int16_t w, uint16_t color) {
+    if ((uint16_t) y >= (uint16_t) _height) return;
+    if (x < 0) { w += x; x = 0; }
+    if (x + w > _width) w = _width - x;
+    if (w <= 0) return;
+    span(pixelIndex(x, y, rotation), stepX(), w, color);
+  }
+  void drawFastVLine(int16_t x, int16_t y, int16_t h, uint16_t color) {
+    if ((uint16_t) x >= (uint16_t) _width) return;
+    if (y < 0) { h += y; y = 0; }
+    if (y + h > _height) h = _height - y;
+    if (h <= 0) return;
+    span(pixelIndex(x, y, rotation), stepY(), h, color);
+  }
+  void fillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color) {
+    if (x < 0) { w += x; x = 0; }
+    if (y < 0) { h += y; y = 0; }
+    if (x + w > _width) w = _width - x;
+    if (y + h > _height) h = _height - y;
+    if (w <= 0 || h <= 0) return;
+
+    uint16_t i = pixelIndex(x, y, rotation);
+    int16_t step_x = stepX();
+    int16_t step_y = stepY();
+    while (h--) {
+      span(i, step_x, w, color);
+      i += step_y;
+    }
+  }
+  void fillScreen(uint16_t color) {
+    uint16_t *p = _matrix;
+    uint16_t *end = _matrix + _num_rows * _num_cols;
+
+    while (p < end) *p++ = color;
+  }
+
+ private:
+  // Framebuffer steps of x + 1 and y + 1 (see DirectMatrix::pixelIndex)
+  int16_t stepX(void) {
+    switch (rotation) {
+    case 1: return _num_cols;
+    case 2: return -1;
+    case 3: return -_num_cols;
+    }
+    return 1;
+  }
+  int16_t stepY(void) {
+    switch (rotation) {
+    case 1: return -1;
+    case 2: return -_num_cols;
+    case 3: return 1;
+    }
+    return _num_cols;
+  }
+  void span(uint16_t i, int16_t step, int16_t n, uint16_t color) {
+    uint16_t *p = _matrix + i;
+
+    for (;;) {
+      *p = color;
+      if (! --n) return;
+      p += step;
+    }
+  }
+};
+
+#endif
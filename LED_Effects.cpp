@@ -0,0 +1,200 @@
+/***************************************************
+  Generative effects for LED_Matrix (see LED_Effects.h).
+
+  Everything is 8 bit integer math: sines and the noise lattice come from
+  PROGMEM tables, colors from 16 color palettes, and each effect writes
+  the framebuffer rows directly.
+
+  License: Apache 2.0 or MIT, at your choice.
+ ****************************************************/
+
+#include "LED_Effects.h"
+
+// 128 + 127 * sin(2 * PI * i / 256)
+static const uint8_t PROGMEM DirectEffects_sin8[256] = {
+    128, 131, 134, 137, 140, 144, 147, 150, 153, 156, 159, 162, 165, 168, 171, 174,
+    177, 179, 182, 185, 188, 191, 193, 196, 199, 201, 204, 206, 209, 211, 213, 216,
+    218, 220, 222, 224, 226, 228, 230, 232, 234, 235, 237, 239, 240, 241, 243, 244,
+    245, 246, 248, 249, 250, 250, 251, 252, 253, 253, 254, 254, 254, 255, 255, 255,
+    255, 255, 255, 255, 254, 254, 254, 253, 253, 252, 251, 250, 250, 249, 248, 246,
+    245, 244, 243, 241, 240, 239, 237, 235, 234, 232, 230, 228, 226, 224, 222, 220,
+    218, 216, 213, 211, 209, 206, 204, 201, 199, 196, 193, 191, 188, 185, 182, 179,
+    177, 174, 171, 168, 165, 162, 159, 156, 153, 150, 147, 144, 140, 137, 134, 131,
+    128, 125, 122, 119, 116, 112, 109, 106, 103, 100,  97,  94,  91,  88,  85,  82,
+     79,  77,  74,  71,  68,  65,  63,  60,  57,  55,  52,  50,  47,  45,  43,  40,
+     38,  36,  34,  32,  30,  28,  26,  24,  22,  21,  19,  17,  16,  15,  13,  12,
+     11,  10,   8,   7,   6,   6,   5,   4,   3,   3,   2,   2,   2,   1,   1,   1,
+      1,   1,   1,   1,   2,   2,   2,   3,   3,   4,   5,   6,   6,   7,   8,  10,
+     11,  12,  13,  15,  16,  17,  19,  21,  22,  24,  26,  28,  30,  32,  34,  36,
+     38,  40,  43,  45,  47,  50,  52,  55,  57,  60,  63,  65,  68,  71,  74,  77,
+     79,  82,  85,  88,  91,  94,  97, 100, 103, 106, 109, 112, 116, 119, 122, 125,
+};
+
+// Ken Perlin's permutation, hashes the noise lattice and gives the value
+// at each point.
+static const uint8_t PROGMEM DirectEffects_perm[256] = {
+    151, 160, 137,  91,  90,  15, 131,  13, 201,  95,  96,  53, 194, 233,   7, 225,
+    140,  36, 103,  30,  69, 142,   8,  99,  37, 240,  21,  10,  23, 190,   6, 148,
+    247, 120, 234,  75,   0,  26, 197,  62,  94, 252, 219, 203, 117,  35,  11,  32,
+     57, 177,  33,  88, 237, 149,  56,  87, 174,  20, 125, 136, 171, 168,  68, 175,
+     74, 165,  71, 134, 139,  48,  27, 166,  77, 146, 158, 231,  83, 111, 229, 122,
+     60, 211, 133, 230, 220, 105,  92,  41,  55,  46, 245,  40, 244, 102, 143,  54,
+     65,  25,  63, 161,   1, 216,  80,  73, 209,  76, 132, 187, 208,  89,  18, 169,
+    200, 196, 135, 130, 116, 188, 159,  86, 164, 100, 109, 198, 173, 186,   3,  64,
+     52, 217, 226, 250, 124, 123,   5, 202,  38, 147, 118, 126, 255,  82,  85, 212,
+    207, 206,  59, 227,  47,  16,  58,  17, 182, 189,  28,  42, 223, 183, 170, 213,
+    119, 248, 152,   2,  44, 154, 163,  70, 221, 153, 101, 155, 167,  43, 172,   9,
+    129,  22,  39, 253,  19,  98, 108, 110,  79, 113, 224, 232, 178, 185, 112, 104,
+    218, 246,  97, 228, 251,  34, 242, 193, 238, 210, 144,  12, 191, 179, 162, 241,
+     81,  51, 145, 235, 249,  14, 239, 107,  49, 192, 214,  31, 181, 199, 106, 157,
+    184,  84, 204, 176, 115, 121,  50,  45, 127,   4, 150, 254, 138, 236, 205,  93,
+    222, 114,  67,  29,  24,  72, 243, 141, 128, 195,  78,  66, 215,  61, 156, 180,
+};
+
+// Hue wheel, red first
+const uint16_t PROGMEM DirectEffects_RainbowPalette[16] = {
+    0x00f, 0x06f, 0x0bf, 0x0fd, 0x0f8, 0x0f2, 0x4f0, 0x9f0,
+    0xff0, 0xf90, 0xf40, 0xf02, 0xf08, 0xf0d, 0xb0f, 0x60f,
+};
+
+// Black, red, orange, yellow, white (red and orange on a bicolor panel)
+const uint16_t PROGMEM DirectEffects_HeatPalette[16] = {
+    0x000, 0x003, 0x006, 0x009, 0x00c, 0x00f, 0x03f, 0x06f,
+    0x09f, 0x0cf, 0x0ff, 0x3ff, 0x6ff, 0x9ff, 0xcff, 0xfff,
+};
+
+// The 16 levels of each color, for single color panels
+const uint16_t PROGMEM DirectEffects_LevelPalette[16] = {
+    0x000, 0x111, 0x222, 0x333, 0x444, 0x555, 0x666, 0x777,
+    0x888, 0x999, 0xaaa, 0xbbb, 0xccc, 0xddd, 0xeee, 0xfff,
+};
+
+static inline uint8_t sin8_P(uint8_t a) {
+    return pgm_read_byte(&DirectEffects_sin8[a]);
+}
+
+static inline uint8_t perm_P(uint8_t i) {
+    return pgm_read_byte(&DirectEffects_perm[i]);
+}
+
+static inline uint16_t color_P(const uint16_t *palette, uint8_t i) {
+    return pgm_read_word(&palette[i]);
+}
+
+// Smoothstep 3t^2 - 2t^3 in 1/256ths, without going over 16 bits
+static inline uint8_t ease8(uint8_t t) {
+    uint16_t t2 = ((uint16_t) t * t) >> 8;
+    return (t2 * ((768 - 2 * t) >> 2)) >> 6;
+}
+
+// a + (b - a) * t / 256, the product would not fit a signed 16 bit int
+static inline uint8_t lerp8(uint8_t a, uint8_t b, uint8_t t) {
+    if (b >= a) return a + (((uint16_t) (b - a) * t) >> 8);
+    return a - (((uint16_t) (a - b) * t) >> 8);
+}
+
+DirectEffects::DirectEffects(DirectMatrix *matrix) {
+    _matrix = matrix;
+    _seed = 1;
+}
+
+uint8_t DirectEffects::sin8(uint8_t a) {
+    return sin8_P(a);
+}
+
+// Perlin's hashing of the 8 corners around the point, with the lattice
+// values taken from the permutation instead of gradients.
+uint8_t DirectEffects::noise8(uint16_t x, uint16_t y, uint16_t z) {
+    uint8_t xi = x >> 8, yi = y >> 8, zi = z >> 8;
+    uint8_t u = ease8(x), v = ease8(y), w = ease8(z);
+
+    uint8_t a = perm_P(xi) + yi;
+    uint8_t aa = perm_P(a) + zi;
+    uint8_t ab = perm_P(a + 1) + zi;
+    uint8_t b = perm_P(xi + 1) + yi;
+    uint8_t ba = perm_P(b) + zi;
+    uint8_t bb = perm_P(b + 1) + zi;
+
+    uint8_t z0 = lerp8(lerp8(perm_P(aa), perm_P(ba), u),
+		       lerp8(perm_P(ab), perm_P(bb), u), v);
+    uint8_t z1 = lerp8(lerp8(perm_P(aa + 1), perm_P(ba + 1), u),
+		       lerp8(perm_P(ab + 1), perm_P(bb + 1), u), v);
+    return lerp8(z0, z1, w);
+}
+
+// Four sines: along the row, along the column (constant for a row) and
+// along both diagonals. Their angles are kept per column and stepped
+// instead of multiplied.
+void DirectEffects::plasma(uint8_t t, const uint16_t *palette) {
+    uint8_t rows = _matrix->rows();
+    uint8_t cols = _matrix->cols();
+
+    for (uint8_t y = 0; y < rows; y++)
+    {
+	uint16_t *pixels = _matrix->row(y);
+	uint16_t row_sin = sin8_P(y * 16 + (t >> 1));
+	uint8_t a = t;			// x * 16 + t
+	uint8_t b = y * 8 - t;		// (x + y) * 8 - t
+	uint8_t c = t * 3 - y * 10;	// (x - y) * 10 + 3t
+
+	for (uint8_t x = 0; x < cols; x++)
+	{
+	    uint16_t sum = row_sin + sin8_P(a) + sin8_P(b) + sin8_P(c);
+	    pixels[x] = color_P(palette, (uint8_t) ((sum >> 2) + t) >> 4);
+	    a += 16;
+	    b += 8;
+	    c += 10;
+	}
+    }
+}
+
+// Row y takes the heat of row y + 1 (not updated yet, rows go down) from
+// the same column or one to the left or right, minus a random loss. The
+// last row is the fuel and flickers between heat 12 and 15.
+void DirectEffects::fire(uint8_t cooling, const uint16_t *palette) {
+    uint8_t rows = _matrix->rows();
+    uint8_t cols = _matrix->cols();
+
+    if (! cooling) cooling = rows <= 240 ? 240 / rows : 1;
+
+    for (uint8_t y = 0; y < rows - 1; y++)
+    {
+	uint16_t *pixels = _matrix->row(y);
+	const uint16_t *below = pixels + cols;
+
+	for (uint8_t x = 0; x < cols; x++)
+	{
+	    uint8_t r = random8();
+	    uint8_t from = x;
+	    if ((r & 3) == 0 && x > 0) from--;
+	    if ((r & 3) == 1 && x < cols - 1) from++;
+	    // (r >> 2) averages 31.5, loss averages cooling / 16 (rounded)
+	    uint8_t loss = ((r >> 2) * cooling + 256) >> 9;
+	    uint8_t heat = below[from] >> 12;
+	    heat = heat > loss ? heat - loss : 0;
+	    pixels[x] = color_P(palette, heat) | (uint16_t) heat << 12;
+	}
+    }
+
+    uint16_t *pixels = _matrix->row(rows - 1);
+    for (uint8_t x = 0; x < cols; x++)
+    {
+	uint8_t heat = 15 - (random8() >> 6);
+	pixels[x] = color_P(palette, heat) | (uint16_t) heat << 12;
+    }
+}
+
+void DirectEffects::noise(uint16_t x, uint16_t y, uint16_t z, uint8_t scale,
+	const uint16_t *palette) {
+    uint8_t rows = _matrix->rows();
+    uint8_t cols = _matrix->cols();
+
+    for (uint8_t row = 0; row < rows; row++, y += scale)
+    {
+	uint16_t *pixels = _matrix->row(row);
+	uint16_t nx = x;
+
+	for (uint8_t col = 0; col < cols; col++, nx += scale)
+	    pixels[col] = color_P(palette, noise8(nx, y, z) >> 4);
+    }
+}
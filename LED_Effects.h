@@ -0,0 +1,63 @@
+#ifndef LED_Effects_h
+#define LED_Effects_h
+
+// Generative effects (plasma, fire, noise) for a DirectMatrix, in integer
+// math with the sine, noise and color tables in PROGMEM. Each call draws
+// one frame straight into the framebuffer, a row at a time, so they run at
+// tens of frames per second on an ATmega where the same effects with sin()
+// and floats manage a few (see extras/bench/bench_effects).
+//
+//   DirectEffects fx(matrix);
+//   for (uint8_t t = 0;; t += 2) {
+//       fx.plasma(t);
+//       matrix->writeDisplay();
+//   }
+//
+// Effects work in panel coordinates (rows as given to the DirectMatrix,
+// row 0 first), the GFX rotation does not apply. Colors come from a
+// palette of 16 colors in PROGMEM, DirectEffects_LevelPalette is the one
+// for single color panels.
+
+#include "LED_Matrix.h"
+
+extern const uint16_t DirectEffects_RainbowPalette[16] PROGMEM;
+extern const uint16_t DirectEffects_HeatPalette[16] PROGMEM;
+extern const uint16_t DirectEffects_LevelPalette[16] PROGMEM;
+
+class DirectEffects {
+ public:
+  DirectEffects(DirectMatrix *);
+
+  // Sum of sines moving with t (1/256th of a period, advance it by 1 to 4
+  // per frame), the palette cycles with it.
+  void plasma(uint8_t t,
+	      const uint16_t *palette = DirectEffects_RainbowPalette);
+  // Flames rising from the last row to row 0, one step per call. Each
+  // pixel keeps its heat (0-15, the palette index) in bits 12-15 of its
+  // color, which the refresh ignores, so there is no second buffer.
+  // cooling is the heat lost per row in 1/16ths on average, 0 makes the
+  // flames about as high as the panel.
+  void fire(uint8_t cooling = 0,
+	    const uint16_t *palette = DirectEffects_HeatPalette);
+  // Slice of 3D value noise: pixel (col, row) is noise8(x + col * scale,
+  // y + row * scale, z), move x/y to scroll and z to morph.
+  void noise(uint16_t x, uint16_t y, uint16_t z, uint8_t scale,
+	     const uint16_t *palette = DirectEffects_RainbowPalette);
+
+  // 128 + 127 * sin(2 * PI * a / 256)
+  static uint8_t sin8(uint8_t a);
+  // Smooth value noise (0-255) at x, y, z in 8.8 fixed point (one lattice
+  // cell per 256).
+  static uint8_t noise8(uint16_t x, uint16_t y, uint16_t z);
+  // Fast pseudo random numbers (fire uses them)
+  uint8_t random8(void) {
+    _seed = _seed * 2053 + 13849;
+    return _seed + (_seed >> 8);
+  }
+
+ private:
+  DirectMatrix *_matrix;
+  uint16_t _seed;
+};
+
+#endif
@@ -33,6 +33,9 @@
 #endif
 #include "LED_Matrix.h"
 #include "Adafruit_GFX.h"
+#ifdef __AVR__
+ #include <avr/sleep.h>
+#endif
 
 // Globals required to pass matrix data into the ISR.
 // (volatile is required for ISRs)
@@ -45,19 +48,535 @@ volatile uint8_t DirectMatrix_ARRAY_COLS;
 volatile uint16_t *DirectMatrix_MATRIX;
 // These go to ground:
 volatile GPIO_pin_t *DirectMatrix_ROW_PINS;
-// Those go to V+
-volatile GPIO_pin_t *DirectMatrix_COL_PINS;
+// Those go to V+, first column pin of each color (unused for SR colors)
+volatile GPIO_pin_t *DirectMatrix_COL_PINS[3];
 // Shift Register Pins that also go to V+
 volatile GPIO_pin_t *DirectMatrix_SR_PINS;
 // How many colors in the array
 volatile uint8_t DirectMatrix_NUM_COLORS;
 // 4 frequencies for the ISR to make PWM colors
 volatile uint32_t DirectMatrix_ISR_FREQ[4];
+// Base period given to begin(), used to restore full quality
+volatile uint32_t DirectMatrix_ISR_BASE;
+// Set by writeDisplay() when the timer is stopped because nothing is lit
+volatile uint8_t DirectMatrix_SUSPENDED;
+// Set by writeDisplay() when all LEDs are either full on or off, in which
+// case all 4 BCM planes are identical and we only need to scan one.
+volatile uint8_t DirectMatrix_SINGLE_PLANE;
+// Set by adaptiveScan(): writeDisplay() does the above for row/column
+// matrices too, not only for the compiled charlieplexed and HUB75 frames
+volatile uint8_t DirectMatrix_ADAPTIVE_SCAN;
+// Row currently lit and when the next refresh interrupt is expected
+volatile uint8_t DirectMatrix_ROW;
+volatile uint32_t DirectMatrix_ISR_NEXT;
+// reserveWindow() state: while RESERVED is set, Timer1 is stopped and the
+// current row stays lit. The extra on time is then taken back from the same
+// row's next slots (DEBT, in us).
+volatile uint8_t DirectMatrix_RESERVED;
+volatile uint32_t DirectMatrix_RESERVE_START;
+volatile uint8_t DirectMatrix_DEBT_ROW;
+volatile uint32_t DirectMatrix_DEBT;
 
 // profiling
 volatile uint32_t DirectMatrix_ISR_runtime;
 volatile uint32_t DirectMatrix_ISR_latency;
+// Rolling averages (over ~4 frames) of the time spent in the ISR and of the
+// duration of a full frame (all rows and all PWM planes), in microseconds.
+volatile uint32_t DirectMatrix_FRAME_BUSY;
+volatile uint32_t DirectMatrix_FRAME_TIME;
+volatile uint32_t DirectMatrix_FRAME_START;
+
+// Overrun handling: an overrun is an ISR run that used more than
+// DirectMatrix_ISR_BUDGET % of the slot it was scheduled for. When
+// DirectMatrix_AUTO_DEGRADE is set, each frame with overruns lowers the
+// quality one step (see DirectMatrix_Degrade) and sets QUALITY_CHANGED.
+volatile uint32_t DirectMatrix_ISR_OVERRUNS;
+volatile uint8_t DirectMatrix_AUTO_DEGRADE = DirectMatrix_AUTO_DEGRADE_DEFAULT;
+volatile uint8_t DirectMatrix_QUALITY;
+volatile uint8_t DirectMatrix_QUALITY_CHANGED;
+// First BCM plane scanned, lower planes are dropped
+volatile uint8_t DirectMatrix_MIN_PLANE;
+// First BCM plane any color is shown in (see DirectMatrix_COLOR1_DEPTH)
+volatile uint8_t DirectMatrix_DEPTH_PLANE;
+// Ghosting suppression (see DirectMatrix::deadTime()/preBlank()): dead
+// time in us and whether the columns go off before the row switch
+volatile uint8_t DirectMatrix_DEAD_TIME;
+volatile uint8_t DirectMatrix_PRE_BLANK;
+
+#if DirectMatrix_TRACE
+// ISR event ring buffer, TRACE_POS is the next entry to write. Recording is
+// paused while traceDump() copies it out.
+volatile DirectMatrix_trace_t DirectMatrix_TRACE_BUF[DirectMatrix_TRACE];
+volatile uint16_t DirectMatrix_TRACE_POS;
+volatile uint16_t DirectMatrix_TRACE_COUNT;
+volatile uint8_t DirectMatrix_TRACE_PAUSED;
+#endif
+
+// idle sleep accounting. DirectMatrix_IDLE_START is only valid while
+// DirectMatrix_SLEEPING is set, the ISR closes the sleep period if it is
+// the interrupt that woke us up.
+volatile uint8_t DirectMatrix_SLEEPING;
+volatile uint32_t DirectMatrix_IDLE_START;
+volatile uint32_t DirectMatrix_idle_time;
+
+// Key matrix sharing the row lines, see DirectMatrix::keys().
+// KEY_RAW is the last sample of each row, KEY_COUNT how many samples in a
+// row it has been stable for and KEY_STATE the debounced state. Events go
+// from the ISR (KEY_HEAD) to readKey() (KEY_TAIL).
+volatile GPIO_pin_t *DirectMatrix_KEY_PINS;
+volatile uint8_t DirectMatrix_NUM_KEYS;
+volatile uint8_t *DirectMatrix_KEY_RAW;
+volatile uint8_t *DirectMatrix_KEY_COUNT;
+volatile uint8_t *DirectMatrix_KEY_STATE;
+volatile uint8_t DirectMatrix_KEY_EVENTS[DirectMatrix_KEY_QUEUE];
+volatile uint8_t DirectMatrix_KEY_HEAD;
+volatile uint8_t DirectMatrix_KEY_TAIL;
+volatile uint16_t DirectMatrix_KEY_LOST;
+
+#ifdef FASTIO
+// Charlieplexing (see DirectMatrix::beginCharlie()): for each step (the
+// anode pin, aka row) and BCM plane, the DDR and PORT bits of the charlie
+// pins on each port, CHARLIE_PORTS pairs per step. The ports are given by
+// a pin code on them and the mask of our pins on them.
+volatile uint8_t DirectMatrix_CHARLIE;
+volatile uint8_t DirectMatrix_CHARLIE_PORTS;
+volatile GPIO_pin_t DirectMatrix_CHARLIE_PORT[DirectMatrix_CHARLIE_MAX_PORTS];
+volatile uint8_t DirectMatrix_CHARLIE_MASK[DirectMatrix_CHARLIE_MAX_PORTS];
+volatile uint8_t *DirectMatrix_CHARLIE_STEPS;
+
+// HUB75 panels (see DirectMatrix::beginHUB75()): for each scan line and
+// BCM plane, the RGB port bits of each column in shift order. The RGB pins
+// are on the port of HUB75_DATA, under HUB75_MASK. Address lines are the
+// row pins.
+volatile uint8_t DirectMatrix_HUB75;
+volatile uint8_t DirectMatrix_HUB75_ADDR_LINES;
+volatile GPIO_pin_t DirectMatrix_HUB75_DATA;
+volatile uint8_t DirectMatrix_HUB75_MASK;
+volatile GPIO_pin_t *DirectMatrix_HUB75_PINS;
+volatile uint8_t *DirectMatrix_HUB75_STEPS;
+
+// Background compilation (see DirectMatrix::backgroundCompile()): the ISR
+// compiles COMPILE_STEPS (row or line, plane) steps per run from COMPILE_POS
+// to COMPILE_END into COMPILE_BUF, then swaps it with the CHARLIE/HUB75
+// steps it shows and sets SINGLE_PLANE to COMPILE_SINGLE.
+DirectMatrix *DirectMatrix_COMPILER;
+volatile uint8_t DirectMatrix_COMPILE_STEPS;
+volatile uint16_t DirectMatrix_COMPILE_POS;
+volatile uint16_t DirectMatrix_COMPILE_END;
+volatile uint8_t *DirectMatrix_COMPILE_BUF;
+volatile uint8_t DirectMatrix_COMPILE_SINGLE;
+
+// Scan program (see DirectMatrix::compileScan()), used by the ISR for
+// row/column matrices when DirectMatrix_SCAN_LEN is not 0
+DirectMatrix_scan_op_t * volatile DirectMatrix_SCAN;
+volatile uint16_t DirectMatrix_SCAN_LEN;
+#endif
+
+// DirectMatrix_MockOutput: colors using it (bit mask) and their columns
+volatile uint8_t DirectMatrix_MOCK;
+volatile uint32_t DirectMatrix_MOCK_COLS[3];
+
+// Per color layout (see DirectMatrix_COLOR1_DEPTH): color c is bits 4c to
+// 4c + 3 of a pixel and is shown in BCM planes DirectMatrix_FIRST_PLANE(c)
+// to 3. These are constants, so at full depth the tests below fold away.
+#define DirectMatrix_DEPTH(c) ((c) == 0 ? DirectMatrix_COLOR1_DEPTH : \
+			       (c) == 1 ? DirectMatrix_COLOR2_DEPTH : \
+			       DirectMatrix_COLOR3_DEPTH)
+#define DirectMatrix_FIRST_PLANE(c) (4 - DirectMatrix_DEPTH(c))
+// Bits of a pixel that are shown, for one color and for all of them
+#define DirectMatrix_SHOWN_BITS(c) \
+    (((0xF << DirectMatrix_FIRST_PLANE(c)) & 0xF) << ((c) * 4))
+#define DirectMatrix_SHOWN (DirectMatrix_SHOWN_BITS(0) | \
+			    DirectMatrix_SHOWN_BITS(1) | \
+			    DirectMatrix_SHOWN_BITS(2))
+
+#ifdef FASTIO
+#define DirectMatrix_digitalRead digitalRead2f
+#else
+#define DirectMatrix_digitalRead digitalRead
+#endif
+
+// Lower the display quality one step to make the ISR fit in its budget:
+// 1: drop the lowest BCM plane, which has the shortest slot (15 -> 14 levels)
+// 2-3: double the base period (refresh rate halved each time)
+// 4: drop the next BCM plane (4 intensity levels left)
+// Called from the ISR at the end of a frame.
+static void DirectMatrix_Degrade(void) {
+    switch (++DirectMatrix_QUALITY)
+    {
+    case 1:
+    case 4:
+	DirectMatrix_MIN_PLANE++;
+	break;
+    case 2:
+    case 3:
+	for (uint8_t i = 0; i < 4; i++) DirectMatrix_ISR_FREQ[i] <<= 1;
+	break;
+    default:
+	// nothing left to give up
+	DirectMatrix_QUALITY--;
+	return;
+    }
+    DirectMatrix_QUALITY_CHANGED = 1;
+}
+
+// Sample the sense inputs while row has been on for its whole slot, and
+// queue press/release events once a change is stable for
+// DirectMatrix_KEY_DEBOUNCE samples. Called from the ISR.
+static void DirectMatrix_ScanKeys(uint8_t row) {
+    uint8_t raw = 0;
+    uint8_t changed;
+
+    for (uint8_t i = 0; i < DirectMatrix_NUM_KEYS; i++)
+    {
+	// a pressed key connects the sense input to the active row
+	if (DirectMatrix_digitalRead(DirectMatrix_KEY_PINS[i]) == ROW_ON)
+	    raw |= 1 << i;
+    }
+
+    if (raw != DirectMatrix_KEY_RAW[row])
+    {
+	DirectMatrix_KEY_RAW[row] = raw;
+	DirectMatrix_KEY_COUNT[row] = 0;
+	return;
+    }
+    if (DirectMatrix_KEY_COUNT[row] >= DirectMatrix_KEY_DEBOUNCE) return;
+    if (++DirectMatrix_KEY_COUNT[row] < DirectMatrix_KEY_DEBOUNCE) return;
+
+    changed = raw ^ DirectMatrix_KEY_STATE[row];
+    DirectMatrix_KEY_STATE[row] = raw;
+    for (uint8_t i = 0; changed; i++, changed >>= 1)
+    {
+	if (! (changed & 1)) continue;
+	uint8_t head = (DirectMatrix_KEY_HEAD + 1) & (DirectMatrix_KEY_QUEUE - 1);
+	if (head == DirectMatrix_KEY_TAIL)
+	{
+	    DirectMatrix_KEY_LOST++;
+	    continue;
+	}
+	DirectMatrix_KEY_EVENTS[DirectMatrix_KEY_HEAD] = 
+	    (row * DirectMatrix_NUM_KEYS + i) | 
+	    ((raw & (1 << i)) ? DirectMatrix_KEY_PRESSED : 0);
+	DirectMatrix_KEY_HEAD = head;
+    }
+}
+
+#ifdef FASTIO
+// Show one charlieplex step: all our pins go high impedance, then the
+// anode and the cathodes of the LEDs lit in this plane are driven.
+// PORT is set before DDR so that a pin never drives its old level.
+static inline void DirectMatrix_CharlieStep(uint8_t row, uint8_t plane) {
+    uint8_t ports = DirectMatrix_CHARLIE_PORTS;
+    volatile uint8_t *step = DirectMatrix_CHARLIE_STEPS + 
+			     (row * 4 + plane) * ports * 2;
+
+    for (uint8_t i = 0; i < ports; i++)
+	GPIO_DDR_REG(DirectMatrix_CHARLIE_PORT[i]) &= 
+	    ~DirectMatrix_CHARLIE_MASK[i];
+    for (uint8_t i = 0; i < ports; i++)
+    {
+	GPIO_pin_t port = DirectMatrix_CHARLIE_PORT[i];
+	uint8_t mask = DirectMatrix_CHARLIE_MASK[i];
+
+	GPIO_PORT_REG(port) = (GPIO_PORT_REG(port) & ~mask) | step[i * 2 + 1];
+	GPIO_DDR_REG(port) |= step[i * 2];
+    }
+}
+
+#if DirectMatrix_SCAN_PROGRAM
+// Run the scan program for row: the previous row goes off, the columns of
+// all colors are set for the plane of pwm, and row goes on. With pwm 0, the
+// columns all go off and the rows are left alone (pre-blanking).
+static inline void DirectMatrix_RunScan(uint8_t row, uint8_t oldrow, 
+					uint8_t pwm) {
+    volatile uint16_t *pixels = DirectMatrix_MATRIX + 
+				row * DirectMatrix_ARRAY_COLS;
+    // 0 in the planes a color is not shown in, which keeps it dark
+    uint16_t pwm_color[3] = { 
+	(uint16_t) (pwm & DirectMatrix_SHOWN_BITS(0)),
+	(uint16_t) ((pwm << 4) & DirectMatrix_SHOWN_BITS(1)),
+	(uint16_t) ((pwm << 8) & DirectMatrix_SHOWN_BITS(2)) };
+    DirectMatrix_scan_op_t *op = DirectMatrix_SCAN;
+
+    for (uint16_t i = DirectMatrix_SCAN_LEN; i; i--, op++)
+    {
+	uint8_t value;
+
+	switch (op->op & 0x0F)
+	{
+	case DirectMatrix_OP_PIXEL:
+	    value = (pixels[op->col] & pwm_color[op->op >> 4]) ? op->lit : 
+								 op->dark;
+	    break;
+	case DirectMatrix_OP_OLD_ROW:
+	    if (! pwm) continue;
+	    digitalWrite(DirectMatrix_ROW_PINS[oldrow], ROW_OFF);
+	    if (DirectMatrix_DEAD_TIME) 
+		delayMicroseconds(DirectMatrix_DEAD_TIME);
+	    continue;
+	case DirectMatrix_OP_ROW:
+	    if (! pwm) continue;
+	    digitalWrite(DirectMatrix_ROW_PINS[row], ROW_ON);
+	    continue;
+	default:
+	    value = op->lit;
+	}
+	GPIO_PORT_REG(op->port) = (GPIO_PORT_REG(op->port) & ~op->mask) | value;
+    }
+}
+#endif
+
+// Show one HUB75 scan line: shift its columns in while the previous line
+// stays lit from the output latches, then blank, select the line, latch
+// and enable.
+static inline void DirectMatrix_HUB75Step(uint8_t row, uint8_t plane) {
+    uint8_t cols = DirectMatrix_ARRAY_COLS;
+    volatile uint8_t *step = DirectMatrix_HUB75_STEPS + (row * 4 + plane) * cols;
+    GPIO_pin_t data = DirectMatrix_HUB75_DATA;
+    GPIO_pin_t clk = DirectMatrix_HUB75_PINS[HUB75_CLK];
+    uint8_t clk_mask = GPIO_PIN_MASK(clk);
+    // the other pins of the data port (CLK can be one of them, it is low)
+    uint8_t keep = GPIO_PORT_REG(data) & ~DirectMatrix_HUB75_MASK;
+
+    for (uint8_t col = 0; col < cols; col++)
+    {
+	GPIO_PORT_REG(data) = keep | step[col];
+	GPIO_PORT_REG(clk) |= clk_mask;
+	GPIO_PORT_REG(clk) &= ~clk_mask;
+    }
+    digitalWrite(DirectMatrix_HUB75_PINS[HUB75_OE], HIGH);
+    for (uint8_t i = 0; i < DirectMatrix_HUB75_ADDR_LINES; i++)
+	digitalWrite(DirectMatrix_ROW_PINS[i], (row >> i) & 1);
+    digitalWrite(DirectMatrix_HUB75_PINS[HUB75_LAT], HIGH);
+    digitalWrite(DirectMatrix_HUB75_PINS[HUB75_LAT], LOW);
+    digitalWrite(DirectMatrix_HUB75_PINS[HUB75_OE], LOW);
+}
+#endif
+
+// Column outputs (see DirectMatrix_COLOR1_OUTPUT in LED_Matrix.h): begin()
+// sets up the pins of a color with all its columns off, and write() sets
+// its columns for the row whose pixels are given, lit where pixel & pwm.
+// They only use globals and get a constant color, so each one inlines to
+// the code for its wiring. A new wiring is a new struct with these 2
+// functions, named in DirectMatrix_COLORn_OUTPUT.
+struct DirectMatrix_DirectOutput {
+    static void begin(uint8_t color) {
+	volatile GPIO_pin_t *col_pins = DirectMatrix_COL_PINS[color];
 
+	for (uint8_t i = 0; i < DirectMatrix_ARRAY_COLS; i++)
+	{
+	    pinMode(col_pins[i], OUTPUT);
+	    digitalWrite(col_pins[i], COL_OFF);
+	}
+    }
+
+    static inline void write(uint8_t color, volatile uint16_t *pixels,
+			     uint16_t pwm) {
+	volatile GPIO_pin_t *col_pins = DirectMatrix_COL_PINS[color];
+
+	for (int8_t col = 0; col <= DirectMatrix_ARRAY_COLS - 1; col++)
+	    digitalWrite(col_pins[col], (pixels[col] & pwm)?COL_ON:COL_OFF);
+    }
+};
+
+// Bit banged shift register, reversed ones (negative latch pin) get the
+// last column first.
+template <uint8_t reversed> struct DirectMatrix_ShiftOutput {
+    static inline GPIO_pin_t latch(uint8_t color) {
+	return reversed ? (GPIO_pin_t) -DirectMatrix_SR_PINS[color] :
+			  DirectMatrix_SR_PINS[color];
+    }
+
+    static void begin(uint8_t color) {
+	pinMode(latch(color), OUTPUT);
+	pinMode(DirectMatrix_SR_PINS[DATA], OUTPUT);
+	pinMode(DirectMatrix_SR_PINS[CLK], OUTPUT);
+	digitalWrite(latch(color), LOW);
+	for (uint8_t i = 0; i < DirectMatrix_ARRAY_COLS; i++)
+	{
+	    digitalWrite(DirectMatrix_SR_PINS[CLK], LOW);
+	    digitalWrite(DirectMatrix_SR_PINS[DATA], COL_OFF);
+	    digitalWrite(DirectMatrix_SR_PINS[CLK], HIGH);
+	}
+	digitalWrite(latch(color), HIGH);
+    }
+
+    static inline void write(uint8_t color, volatile uint16_t *pixels,
+			     uint16_t pwm) {
+	uint8_t cols = DirectMatrix_ARRAY_COLS;
+
+	digitalWrite(latch(color), LOW);
+	for (uint8_t i = 0; i < cols; i++)
+	{
+	    uint8_t col = reversed ? cols - 1 - i : i;
+	    digitalWrite(DirectMatrix_SR_PINS[CLK], LOW);
+	    digitalWrite(DirectMatrix_SR_PINS[DATA], 
+		(pixels[col] & pwm)?COL_ON:COL_OFF);
+	    digitalWrite(DirectMatrix_SR_PINS[CLK], HIGH);
+	}
+	digitalWrite(latch(color), HIGH);
+    }
+};
+typedef DirectMatrix_ShiftOutput<0> DirectMatrix_SROutput;
+typedef DirectMatrix_ShiftOutput<1> DirectMatrix_ReversedSROutput;
+
+// Shift register on the SPI hardware, 8 columns at a time. When the number
+// of columns is not a multiple of 8, the padding goes first and falls off
+// the end of the shift registers.
+struct DirectMatrix_SPIOutput {
+    static inline void transfer(uint8_t value) {
+#ifdef SPDR
+	SPDR = value;
+	while (! (SPSR & _BV(SPIF)));
+#else
+	// no SPI hardware (host builds): the same bits on DATA/CLK
+	for (uint8_t bit = 0x80; bit; bit >>= 1)
+	{
+	    digitalWrite(DirectMatrix_SR_PINS[CLK], LOW);
+	    digitalWrite(DirectMatrix_SR_PINS[DATA], (value & bit)?HIGH:LOW);
+	    digitalWrite(DirectMatrix_SR_PINS[CLK], HIGH);
+	}
+#endif
+    }
+
+    static void begin(uint8_t color) {
+	pinMode(DirectMatrix_SR_PINS[color], OUTPUT);
+	pinMode(DirectMatrix_SR_PINS[DATA], OUTPUT);
+	pinMode(DirectMatrix_SR_PINS[CLK], OUTPUT);
+#ifdef SPDR
+	// SS must be an output for the SPI to stay master. MSB first, mode
+	// 0, F_CPU / 2.
+#ifdef FASTIO
+	pinMode2(SS, OUTPUT);
+#else
+	pinMode(SS, OUTPUT);
+#endif
+	SPCR = _BV(SPE) | _BV(MSTR);
+	SPSR = _BV(SPI2X);
+#endif
+	digitalWrite(DirectMatrix_SR_PINS[color], LOW);
+	for (uint8_t i = 0; i < DirectMatrix_ARRAY_COLS; i += 8)
+	    transfer(COL_OFF ? 0xFF : 0);
+	digitalWrite(DirectMatrix_SR_PINS[color], HIGH);
+    }
+
+    static inline void write(uint8_t color, volatile uint16_t *pixels,
+			     uint16_t pwm) {
+	uint8_t invert = COL_OFF ? 0xFF : 0;
+	uint8_t bit = 0x80 >> (-DirectMatrix_ARRAY_COLS & 7);
+	uint8_t value = 0;
+
+	digitalWrite(DirectMatrix_SR_PINS[color], LOW);
+	for (uint8_t col = 0; col < DirectMatrix_ARRAY_COLS; col++)
+	{
+	    if (pixels[col] & pwm) value |= bit;
+	    bit >>= 1;
+	    if (! bit)
+	    {
+		transfer(value ^ invert);
+		value = 0;
+		bit = 0x80;
+	    }
+	}
+	digitalWrite(DirectMatrix_SR_PINS[color], HIGH);
+    }
+};
+
+// No pins: the lit columns go to DirectMatrix_MOCK_COLS[color], bit n for
+// column n.
+struct DirectMatrix_MockOutput {
+    static void begin(uint8_t color) {
+	DirectMatrix_MOCK |= 1 << color;
+	DirectMatrix_MOCK_COLS[color] = 0;
+    }
+
+    static inline void write(uint8_t color, volatile uint16_t *pixels,
+			     uint16_t pwm) {
+	uint32_t bits = 0;
+
+	for (uint8_t col = 0; col < DirectMatrix_ARRAY_COLS; col++)
+	    if (pixels[col] & pwm) bits |= (uint32_t) 1 << col;
+	DirectMatrix_MOCK_COLS[color] = bits;
+    }
+};
+
+// The wiring of each color comes from the sr_pins given to begin(): DINV
+// for direct columns, a negative latch pin for a reversed shift register.
+struct DirectMatrix_AutoOutput {
+    static void begin(uint8_t color) {
+	if (DirectMatrix_SR_PINS[color] == DINV)
+	    DirectMatrix_DirectOutput::begin(color);
+	else if (DirectMatrix_SR_PINS[color] > 32768)
+	    DirectMatrix_ReversedSROutput::begin(color);
+	else
+	    DirectMatrix_SROutput::begin(color);
+    }
+
+    static inline void write(uint8_t color, volatile uint16_t *pixels,
+			     uint16_t pwm) {
+	if (DirectMatrix_SR_PINS[color] == DINV)
+	    DirectMatrix_DirectOutput::write(color, pixels, pwm);
+	else if (DirectMatrix_SR_PINS[color] > 32768)
+	    DirectMatrix_ReversedSROutput::write(color, pixels, pwm);
+	else
+	    DirectMatrix_SROutput::write(color, pixels, pwm);
+    }
+};
+
+#ifdef FASTIO
+// How compileScan() writes the columns of an output: the outputs it does
+// not know (SPI, mock, new ones) can't be compiled.
+#define DirectMatrix_SCAN_NONE 0
+#define DirectMatrix_SCAN_AUTO 1
+#define DirectMatrix_SCAN_DIRECT 2
+#define DirectMatrix_SCAN_SR 3
+#define DirectMatrix_SCAN_REVERSED_SR 4
+template <class Output> struct DirectMatrix_ScanWiring {
+    enum { kind = DirectMatrix_SCAN_NONE };
+};
+template <> struct DirectMatrix_ScanWiring<DirectMatrix_AutoOutput> {
+    enum { kind = DirectMatrix_SCAN_AUTO };
+};
+template <> struct DirectMatrix_ScanWiring<DirectMatrix_DirectOutput> {
+    enum { kind = DirectMatrix_SCAN_DIRECT };
+};
+template <> struct DirectMatrix_ScanWiring<DirectMatrix_SROutput> {
+    enum { kind = DirectMatrix_SCAN_SR };
+};
+template <> struct DirectMatrix_ScanWiring<DirectMatrix_ReversedSROutput> {
+    enum { kind = DirectMatrix_SCAN_REVERSED_SR };
+};
+
+static uint8_t DirectMatrix_ScanKind(uint8_t color) {
+    switch (color)
+    {
+    case 0: return DirectMatrix_ScanWiring<DirectMatrix_COLOR1_OUTPUT>::kind;
+    case 1: return DirectMatrix_ScanWiring<DirectMatrix_COLOR2_OUTPUT>::kind;
+    }
+    return DirectMatrix_ScanWiring<DirectMatrix_COLOR3_OUTPUT>::kind;
+}
+#endif
+
+// Set the columns of a color for the plane of pwm. In a plane the color is
+// not shown in, its columns are blanked on the first row and left dark for
+// the others.
+template <class Output, uint8_t color>
+static inline void DirectMatrix_WriteColor(volatile uint16_t *pixels,
+					   uint8_t pwm, uint8_t row) {
+    uint16_t pwm_color = (pwm << (color * 4)) & DirectMatrix_SHOWN_BITS(color);
+
+    if (DirectMatrix_DEPTH(color) >= 4 || pwm_color || row == 0)
+	Output::write(color, pixels, pwm_color);
+}
+
+// All the columns off, whatever the plane (pre-blanking)
+static inline void DirectMatrix_BlankColumns(volatile uint16_t *pixels) {
+    DirectMatrix_COLOR1_OUTPUT::write(0, pixels, 0);
+    if (DirectMatrix_NUM_COLORS > 1) 
+	DirectMatrix_COLOR2_OUTPUT::write(1, pixels, 0);
+    if (DirectMatrix_NUM_COLORS > 2) 
+	DirectMatrix_COLOR3_OUTPUT::write(2, pixels, 0);
+}
 
 // ISR to refresh one matrix row
 // This must be fast since it blocks interrupts and can only use globals.
@@ -83,71 +602,146 @@ void DirectMatrix_RefreshPWMLine(void) {
     // we use 4 ISR frequencies for 16 bits of PWM and keep track of which
     // next interval (powers of 2) we set for next time this ISR should run
     static uint8_t isr_freq_offset = 0;
+    // ISR time spent in the current frame
+    static uint32_t frame_busy = 0;
+    // set when the last period was shortened to pay back a reserveWindow()
+    static uint8_t period_changed = 0;
+    static uint8_t frame_overruns = 0;
+    uint8_t frame_done = 0;
+    uint32_t period;
     int8_t oldrow;
-    int8_t col_pin_offset = 0;
-    uint16_t pwm_shifted = pwm;
+    volatile uint16_t *pixels;
 
     // Record latency between 2 calls
     DirectMatrix_ISR_latency = micros() - time;
     time = micros();
 
+    if (DirectMatrix_SLEEPING)
+    {
+	DirectMatrix_idle_time += time - DirectMatrix_IDLE_START;
+	DirectMatrix_SLEEPING = 0;
+    }
+
     if (row == 0) 
     {
-	// When scanning a new row, set the new timer frequency for this run.
-	Timer1.setPeriod(DirectMatrix_ISR_FREQ[isr_freq_offset]);
+	// Single plane content only needs the slowest plane (any bit works
+	// since they are all the same). Picking the last plane makes the
+	// wrap below bring us back to plane 0 if the content changes.
+	if (DirectMatrix_SINGLE_PLANE)
+	{
+	    pwm = DirectMatrix_PWM_LEVELS >> 1;
+	    isr_freq_offset = 3;
+	}
+	// Skip the planes dropped by DirectMatrix_Degrade() and the ones no
+	// color is shown in
+	else if (isr_freq_offset < DirectMatrix_MIN_PLANE ||
+		 isr_freq_offset < DirectMatrix_DEPTH_PLANE)
+	{
+	    isr_freq_offset = DirectMatrix_MIN_PLANE;
+	    if (isr_freq_offset < DirectMatrix_DEPTH_PLANE)
+		isr_freq_offset = DirectMatrix_DEPTH_PLANE;
+	    pwm = 1 << isr_freq_offset;
+	}
 	oldrow = DirectMatrix_ARRAY_ROWS - 1;
     }
     else 
     {
 	oldrow = row - 1;
     }
-    // Before setting the columns, shut off the previous row
-    digitalWrite(DirectMatrix_ROW_PINS[oldrow], ROW_OFF);
 
-    for (int8_t color = 0; color < DirectMatrix_NUM_COLORS; color++)
+    // When scanning a new row, set the new timer frequency for this run.
+    // If this row was kept on longer by reserveWindow(), shorten its slot
+    // (by up to half) until the extra on time has been paid back.
+    period = DirectMatrix_ISR_FREQ[isr_freq_offset];
+    if (DirectMatrix_DEBT && row == DirectMatrix_DEBT_ROW)
     {
-	// If no SR is defined for this color, direct color mapping
-	if (DirectMatrix_SR_PINS[color] == DINV)
-	{
-	    for (int8_t col = 0; col <= DirectMatrix_ARRAY_COLS - 1; col++)
-	    {
-		digitalWrite(DirectMatrix_COL_PINS[col + col_pin_offset],
-		    (DirectMatrix_MATRIX[row * DirectMatrix_ARRAY_COLS + col] &
-		     pwm_shifted)?COL_ON:COL_OFF);
-	    }
-	}
-	else if (DirectMatrix_SR_PINS[color] > 32768)
+	uint32_t take = DirectMatrix_DEBT;
+	if (take > period >> 1) take = period >> 1;
+	DirectMatrix_DEBT -= take;
+	period -= take;
+	Timer1.setPeriod(period);
+	period_changed = 1;
+    }
+    else if (row == 0 || period_changed)
+    {
+	Timer1.setPeriod(period);
+	period_changed = 0;
+    }
+    DirectMatrix_ISR_NEXT = time + period;
+#ifdef FASTIO
+    if (DirectMatrix_CHARLIE)
+    {
+	DirectMatrix_CharlieStep(row, isr_freq_offset);
+    }
+    else if (DirectMatrix_HUB75)
+    {
+	DirectMatrix_HUB75Step(row, isr_freq_offset);
+    }
+#if DirectMatrix_SCAN_PROGRAM
+    else if (DirectMatrix_SCAN_LEN)
+    {
+	if (DirectMatrix_NUM_KEYS) DirectMatrix_ScanKeys(oldrow);
+	if (DirectMatrix_PRE_BLANK) DirectMatrix_RunScan(row, oldrow, 0);
+	DirectMatrix_RunScan(row, oldrow, pwm);
+    }
+#endif
+    else
+#endif
+    {
+	if (DirectMatrix_NUM_KEYS) DirectMatrix_ScanKeys(oldrow);
+	pixels = DirectMatrix_MATRIX + row * DirectMatrix_ARRAY_COLS;
+	if (DirectMatrix_PRE_BLANK) DirectMatrix_BlankColumns(pixels);
+	// Before setting the columns, shut off the previous row, and give its
+	// driver the dead time to really turn off
+	digitalWrite(DirectMatrix_ROW_PINS[oldrow], ROW_OFF);
+	if (DirectMatrix_DEAD_TIME) delayMicroseconds(DirectMatrix_DEAD_TIME);
+	DirectMatrix_WriteColor<DirectMatrix_COLOR1_OUTPUT, 0>(pixels, pwm, row);
+	if (DirectMatrix_NUM_COLORS > 1) 
+	    DirectMatrix_WriteColor<DirectMatrix_COLOR2_OUTPUT, 1>(pixels, pwm,
+								   row);
+	if (DirectMatrix_NUM_COLORS > 2) 
+	    DirectMatrix_WriteColor<DirectMatrix_COLOR3_OUTPUT, 2>(pixels, pwm,
+								   row);
+
+	// Now that the colums are set, turn the row on
+	digitalWrite(DirectMatrix_ROW_PINS[row], ROW_ON);
+    }
+#ifdef FASTIO
+    // The row is lit, use the rest of the slot for the next steps of a frame
+    // given to writeDisplay() in the background, and show it when complete
+    if (DirectMatrix_COMPILE_POS < DirectMatrix_COMPILE_END)
+    {
+	uint16_t pos = DirectMatrix_COMPILE_POS;
+	uint16_t end = pos + DirectMatrix_COMPILE_STEPS;
+
+	if (end > DirectMatrix_COMPILE_END) end = DirectMatrix_COMPILE_END;
+	for (; pos < end; pos++)
+	    DirectMatrix_COMPILER->compileStep(pos, DirectMatrix_COMPILE_BUF);
+	DirectMatrix_COMPILE_POS = pos;
+	if (pos == DirectMatrix_COMPILE_END)
 	{
-	    digitalWrite((GPIO_pin_t) -DirectMatrix_SR_PINS[color], LOW);
-	    for (int8_t col = DirectMatrix_ARRAY_COLS - 1; col >= 0; col--)
+	    volatile uint8_t *shown;
+	    if (DirectMatrix_CHARLIE)
 	    {
-		digitalWrite(DirectMatrix_SR_PINS[CLK], LOW);
-		digitalWrite(DirectMatrix_SR_PINS[DATA], 
-		    (DirectMatrix_MATRIX[row * DirectMatrix_ARRAY_COLS + col] &
-		     pwm_shifted)?COL_ON:COL_OFF);
-		digitalWrite(DirectMatrix_SR_PINS[CLK], HIGH);
+		shown = DirectMatrix_CHARLIE_STEPS;
+		DirectMatrix_CHARLIE_STEPS = DirectMatrix_COMPILE_BUF;
 	    }
-	    digitalWrite((GPIO_pin_t) -DirectMatrix_SR_PINS[color], HIGH);
-	}
-	else
-	{
-	    digitalWrite(DirectMatrix_SR_PINS[color], LOW);
-	    for (int8_t col = 0; col <= DirectMatrix_ARRAY_COLS - 1; col++)
+	    else
 	    {
-		digitalWrite(DirectMatrix_SR_PINS[CLK], LOW);
-		digitalWrite(DirectMatrix_SR_PINS[DATA], 
-		    (DirectMatrix_MATRIX[row * DirectMatrix_ARRAY_COLS + col] &
-		     pwm_shifted)?COL_ON:COL_OFF);
-		digitalWrite(DirectMatrix_SR_PINS[CLK], HIGH);
+		shown = DirectMatrix_HUB75_STEPS;
+		DirectMatrix_HUB75_STEPS = DirectMatrix_COMPILE_BUF;
 	    }
-	    digitalWrite(DirectMatrix_SR_PINS[color], HIGH);
+	    DirectMatrix_COMPILE_BUF = shown;
+	    DirectMatrix_SINGLE_PLANE = DirectMatrix_COMPILE_SINGLE;
 	}
-	pwm_shifted <<= 4;
-	col_pin_offset += DirectMatrix_ARRAY_COLS;
     }
-
-    // Now that the colums are set, turn the row on
-    digitalWrite(DirectMatrix_ROW_PINS[row], ROW_ON);
+#endif
+    DirectMatrix_ROW = row;
+#if DirectMatrix_TRACE
+    uint16_t trace_time = time;
+    uint8_t trace_row = row;
+    uint8_t trace_plane = isr_freq_offset;
+#endif
 
     row++;
     if (row >= DirectMatrix_ARRAY_ROWS)
@@ -159,12 +753,57 @@ void DirectMatrix_RefreshPWMLine(void) {
 	{
 	    pwm = 1;
 	    isr_freq_offset = 0;
+	    frame_done = 1;
 	}
     }
 
     // Record how long the function took
     DirectMatrix_ISR_runtime = micros() - time;
     time = micros();
+
+#if DirectMatrix_TRACE
+    // Record this run in the trace ring buffer
+    if (! DirectMatrix_TRACE_PAUSED)
+    {
+	volatile DirectMatrix_trace_t *event = 
+	    &DirectMatrix_TRACE_BUF[DirectMatrix_TRACE_POS];
+	event->time = trace_time;
+	event->row = trace_row;
+	event->plane = trace_plane;
+	event->runtime = DirectMatrix_ISR_runtime;
+	if (++DirectMatrix_TRACE_POS >= DirectMatrix_TRACE)
+	    DirectMatrix_TRACE_POS = 0;
+	if (DirectMatrix_TRACE_COUNT < DirectMatrix_TRACE)
+	    DirectMatrix_TRACE_COUNT++;
+    }
+#endif
+
+    // CPU load accounting: 2 additions per interrupt, and a cheap rolling
+    // average (1/4 weight for the new value) once per frame.
+    frame_busy += DirectMatrix_ISR_runtime;
+    if (DirectMatrix_ISR_runtime * 100 > period * DirectMatrix_ISR_BUDGET)
+    {
+	DirectMatrix_ISR_OVERRUNS++;
+	frame_overruns = 1;
+    }
+    if (frame_done)
+    {
+	if (frame_overruns && DirectMatrix_AUTO_DEGRADE) DirectMatrix_Degrade();
+	frame_overruns = 0;
+	uint32_t frame_time = time - DirectMatrix_FRAME_START;
+	// the first frame seeds the averages
+	if (! DirectMatrix_FRAME_TIME)
+	{
+	    DirectMatrix_FRAME_BUSY = frame_busy;
+	    DirectMatrix_FRAME_TIME = frame_time;
+	}
+	DirectMatrix_FRAME_BUSY += (frame_busy >> 2) -
+				   (DirectMatrix_FRAME_BUSY >> 2);
+	DirectMatrix_FRAME_TIME += (frame_time >> 2) -
+				   (DirectMatrix_FRAME_TIME >> 2);
+	frame_busy = 0;
+	DirectMatrix_FRAME_START = time;
+    }
 }
 
 DirectMatrix::DirectMatrix(uint8_t num_rows, uint8_t num_cols, 
@@ -172,11 +811,17 @@ DirectMatrix::DirectMatrix(uint8_t num_rows, uint8_t num_cols,
     _num_rows = num_rows;
     _num_cols = num_cols;
     _num_colors = num_colors;
+    _pin_table = NULL;
 
     // These need to be global so that the ISR can get to them.
     DirectMatrix_ARRAY_ROWS = num_rows;
     DirectMatrix_ARRAY_COLS = num_cols;
     DirectMatrix_NUM_COLORS = num_colors;
+    // at least the last plane is scanned, even if no color is shown
+    DirectMatrix_DEPTH_PLANE = 3;
+    for (uint8_t color = 0; color < num_colors; color++)
+	if (DirectMatrix_FIRST_PLANE(color) < DirectMatrix_DEPTH_PLANE)
+	    DirectMatrix_DEPTH_PLANE = DirectMatrix_FIRST_PLANE(color);
 
     if (not common)
     {
@@ -202,23 +847,62 @@ DirectMatrix::DirectMatrix(uint8_t num_rows, uint8_t num_cols,
     DirectMatrix_MATRIX = _matrix;
 }
 
+// If this matrix is the one shown, the refresh stops (the pins are left as
+// they are) and what begin*() and keys() allocated is freed with it.
+DirectMatrix::~DirectMatrix() {
+    if (DirectMatrix_MATRIX == _matrix)
+    {
+	Timer1.stop();
+	Timer1.detachInterrupt();
+	DirectMatrix_MATRIX = NULL;
+	DirectMatrix_SUSPENDED = 0;
+	DirectMatrix_NUM_KEYS = 0;
+	if (DirectMatrix_KEY_RAW) free((void *) DirectMatrix_KEY_RAW);
+	DirectMatrix_KEY_RAW = NULL;
+#ifdef FASTIO
+	backgroundCompile(0);
+	if (DirectMatrix_CHARLIE_STEPS) free((void *) DirectMatrix_CHARLIE_STEPS);
+	DirectMatrix_CHARLIE_STEPS = NULL;
+	DirectMatrix_CHARLIE = 0;
+	if (DirectMatrix_HUB75_STEPS) free((void *) DirectMatrix_HUB75_STEPS);
+	DirectMatrix_HUB75_STEPS = NULL;
+	DirectMatrix_HUB75 = 0;
+	if (DirectMatrix_SCAN) free(DirectMatrix_SCAN);
+	DirectMatrix_SCAN = NULL;
+	DirectMatrix_SCAN_LEN = 0;
+#endif
+    }
+    if (_pin_table) free(_pin_table);
+    free(_matrix);
+}
+
 // Array of of pins for vertical rows, and columns.
 // __sr_pins can have negative values to fill rows backwards if you wired
 // in that order.
 void DirectMatrix::begin(GPIO_pin_t __row_pins[], GPIO_pin_t __col_pins[], 
 	GPIO_pin_t __sr_pins[], uint32_t __ISR_freq) {
+    begin_pins(__row_pins, __col_pins, __sr_pins, __ISR_freq, 0);
+}
+
+// With compact set, __col_pins only has the columns of the colors that are
+// not on a shift register, otherwise num_cols entries for each color.
+void DirectMatrix::begin_pins(GPIO_pin_t __row_pins[], 
+	GPIO_pin_t __col_pins[], GPIO_pin_t __sr_pins[], uint32_t __ISR_freq,
+	uint8_t compact) {
+    GPIO_pin_t *color_pins = __col_pins;
+
     _row_pins = __row_pins;
     _col_pins = __col_pins;
     _sr_pins = __sr_pins;
 
     // These need to be global so that the ISR can get to them
     DirectMatrix_ROW_PINS = _row_pins;
-    DirectMatrix_COL_PINS = _col_pins;
+    for (uint8_t color = 0; color < _num_colors; color++)
+    {
+	DirectMatrix_COL_PINS[color] = color_pins;
+	if (! compact || _sr_pins[color] == DINV) color_pins += _num_cols;
+    }
     DirectMatrix_SR_PINS = _sr_pins;
-    DirectMatrix_ISR_FREQ[0] = __ISR_freq;
-    DirectMatrix_ISR_FREQ[1] = __ISR_freq << 1;
-    DirectMatrix_ISR_FREQ[2] = __ISR_freq << 2;
-    DirectMatrix_ISR_FREQ[3] = __ISR_freq << 3;
 
     // Init the rows and cols with the opposite voltage to turn them off.
     for (uint8_t i = 0; i < _num_rows; i++)
@@ -228,64 +912,630 @@ void DirectMatrix::begin(GPIO_pin_t __row_pins[], GPIO_pin_t __col_pins[],
     }
     
     // Setup output pins.
+    DirectMatrix_COLOR1_OUTPUT::begin(0);
+    if (_num_colors > 1) DirectMatrix_COLOR2_OUTPUT::begin(1);
+    if (_num_colors > 2) DirectMatrix_COLOR3_OUTPUT::begin(2);
+#if DirectMatrix_SCAN_PROGRAM && defined(FASTIO)
+    compileScan();
+#endif
+
+    start(__ISR_freq);
+}
+
+void DirectMatrix::start(uint32_t __ISR_freq) {
+    DirectMatrix_ISR_BASE = __ISR_freq;
+    autoDegrade(DirectMatrix_AUTO_DEGRADE);
+
+    // We want at least 40Hz refresh at lowest intensity  
+    // x 8 rows x 16 levels of intensity -> 5120Hz or 195us
+    // I get good results by making the quickest interrupt be
+    // 150us, and 300, 600, 1200us for the other ones.
+    DirectMatrix_FRAME_START = micros();
+    Timer1.initialize(DirectMatrix_ISR_FREQ[0]);
+    Timer1.attachInterrupt(DirectMatrix_RefreshPWMLine);
+}
+
+// begin() with the pin arrays in flash, e.g.
+// const GPIO_pin_t line_pins[] PROGMEM = { DP5, DP6, ... };
+// The arrays have the same layout as for begin(), but only the pins in use
+// are copied to RAM, in one table: the rows, the columns of the colors that
+// are not on a shift register, and the 5 shift register pins.
+void DirectMatrix::begin_P(const GPIO_pin_t __row_pins[], 
+	const GPIO_pin_t __col_pins[], const GPIO_pin_t __sr_pins[], 
+	uint32_t __ISR_freq) {
+    GPIO_pin_t *old_table = _pin_table;
+    GPIO_pin_t *table, *col_pins, *sr_pins;
+    GPIO_pin_t sr[5];
+    uint8_t direct_colors = 0;
+
+    memcpy_P(sr, __sr_pins, sizeof(sr));
+    for (uint8_t color = 0; color < _num_colors; color++)
+	if (sr[color] == DINV) direct_colors++;
+
+    if (! (table = (GPIO_pin_t *) malloc((_num_rows + 
+	    direct_colors * _num_cols + 5) * sizeof(GPIO_pin_t))))
+    {
+	while (1) {
+	    Serial.println(F("Malloc failed in DirectMatrix::begin_P"));
+	}
+    }
+    memcpy_P(table, __row_pins, _num_rows * sizeof(GPIO_pin_t));
+    col_pins = table + _num_rows;
     for (uint8_t color = 0; color < _num_colors; color++)
     {
-	if (_sr_pins[color] == DINV) 
+	if (sr[color] != DINV) continue;
+	memcpy_P(col_pins, __col_pins + color * _num_cols, 
+		 _num_cols * sizeof(GPIO_pin_t));
+	col_pins += _num_cols;
+    }
+    sr_pins = col_pins;
+    memcpy(sr_pins, sr, sizeof(sr));
+    _pin_table = table;
+
+    begin_pins(table, table + _num_rows, sr_pins, __ISR_freq, 1);
+    // The ISR uses the new table from now on
+    if (old_table) free(old_table);
+}
+
+#ifdef FASTIO
+// Charlieplexed LEDs: n pins give n * (n - 1) LEDs, one between each
+// ordered pair of pins. Construct with n rows, n - 1 cols and 1 color:
+// pixel (x, y) is the LED with its anode on pins[y] and its cathode on
+// the x-th of the other pins, in order (pins[x] if x < y, else pins[x + 1]).
+// Each row slot drives one anode high and the lit cathodes low, all other
+// pins are high impedance. The DDR/PORT values of each step and BCM plane
+// are compiled by writeDisplay(), so unlike row/column matrices, what is
+// drawn only shows after writeDisplay().
+// Put a resistor on each pin, each LED then has 2 in series.
+void DirectMatrix::beginCharlie(GPIO_pin_t pins[], uint32_t __ISR_freq) {
+    uint8_t ports = 0;
+
+    for (uint8_t i = 0; i < _num_rows; i++)
+    {
+	uint8_t p;
+	for (p = 0; p < ports; p++)
+	    if ((DirectMatrix_CHARLIE_PORT[p] & 0xFF) == (pins[i] & 0xFF)) break;
+	if (p == ports)
 	{
-	    for (uint8_t i = 0; i < _num_cols; i++)
+	    if (ports == DirectMatrix_CHARLIE_MAX_PORTS) 
 	    {
-		pinMode(_col_pins[color * _num_rows + i], OUTPUT);
-		digitalWrite(_col_pins[color * _num_rows + i], COL_OFF);
+		while (1) {
+		    Serial.println(F("Too many ports in DirectMatrix::beginCharlie"));
+		}
 	    }
+	    DirectMatrix_CHARLIE_PORT[p] = pins[i];
+	    DirectMatrix_CHARLIE_MASK[p] = 0;
+	    ports++;
+	}
+	DirectMatrix_CHARLIE_MASK[p] |= GPIO_PIN_MASK(pins[i]);
+	pinMode(pins[i], INPUT);
+    }
+
+    // all off until the first writeDisplay()
+    if (! (DirectMatrix_CHARLIE_STEPS = (uint8_t *) calloc(_num_rows * 4, 
+							   ports * 2)))
+    {
+	while (1) {
+	    Serial.println(F("Malloc failed in DirectMatrix::beginCharlie"));
 	}
-	else if (_sr_pins[color] > 32768)
+    }
+    DirectMatrix_CHARLIE_PORTS = ports;
+    DirectMatrix_CHARLIE = 1;
+
+    _row_pins = pins;
+    DirectMatrix_ROW_PINS = pins;
+    start(__ISR_freq);
+}
+
+// Build the DDR/PORT bits of each step and plane from the framebuffer
+void DirectMatrix::compileCharlie(void) {
+    // A step rewritten while the ISR shows it only glitches for one slot.
+    for (uint8_t row = 0; row < _num_rows; row++)
+	for (uint8_t plane = 0; plane < 4; plane++)
+	    compileCharlieStep(row, plane, DirectMatrix_CHARLIE_STEPS);
+}
+
+// The DDR/PORT bits of one step and plane, into steps
+void DirectMatrix::compileCharlieStep(uint8_t row, uint8_t plane,
+				      volatile uint8_t *steps) {
+    uint8_t ports = DirectMatrix_CHARLIE_PORTS;
+    GPIO_pin_t anode = _row_pins[row];
+    uint8_t step[DirectMatrix_CHARLIE_MAX_PORTS * 2];
+    uint8_t lit = 0;
+
+    memset(step, 0, sizeof(step));
+    for (uint8_t col = 0; col < _num_cols; col++)
+    {
+	if (! (_matrix[row * _num_cols + col] & 
+	       DirectMatrix_SHOWN_BITS(0) & (1 << plane))) continue;
+	GPIO_pin_t cathode = _row_pins[col < row ? col : col + 1];
+	for (uint8_t p = 0; p < ports; p++)
+	    if ((DirectMatrix_CHARLIE_PORT[p] & 0xFF) == (cathode & 0xFF))
+		step[p * 2] |= GPIO_PIN_MASK(cathode);
+	lit = 1;
+    }
+    for (uint8_t p = 0; lit && p < ports; p++)
+    {
+	if ((DirectMatrix_CHARLIE_PORT[p] & 0xFF) != (anode & 0xFF)) continue;
+	step[p * 2] |= GPIO_PIN_MASK(anode);
+	step[p * 2 + 1] |= GPIO_PIN_MASK(anode);
+    }
+    memcpy((uint8_t *) steps + (row * 4 + plane) * ports * 2, step, ports * 2);
+}
+
+// HUB75 RGB panels (32x16 1/8 scan, 32x32 1/16 scan...): the panel has 2
+// halves scanned together, row y and y + rows / 2 get their data from
+// R1 G1 B1 and R2 G2 B2 and are selected by the address lines (A, B, C...,
+// log2(rows / 2) of them). Columns are shifted in on CLK, moved to the
+// outputs by LAT, and OE (active low) enables them.
+// rgb_pins: R1 G1 B1 R2 G2 B2, all on the same port (any bits of it)
+// addr_pins: A B C (D)
+// ctrl_pins: HUB75_CLK, HUB75_LAT, HUB75_OE
+// Each ISR run shows one address (scan line) for one BCM plane, from port
+// bytes compiled by writeDisplay(), so as with charlieplexing, what is
+// drawn only shows after writeDisplay(). The compiled planes take
+// rows / 2 * 4 * cols bytes on top of the frame buffer: 1KB each for
+// 32x16, which is more than an ATmega328 has, use a 16x16 or 32x8 part of
+// the panel there, or an ATmega2560.
+void DirectMatrix::beginHUB75(GPIO_pin_t rgb_pins[], GPIO_pin_t addr_pins[],
+	GPIO_pin_t ctrl_pins[], uint32_t __ISR_freq) {
+    uint8_t lines = _num_rows / 2;
+    uint8_t addr_lines = 0;
+    uint8_t mask = 0;
+
+    while ((1 << addr_lines) < lines) addr_lines++;
+    for (uint8_t i = 0; i < 6; i++)
+    {
+	if ((rgb_pins[i] & 0xFF) != (rgb_pins[0] & 0xFF))
 	{
-	    pinMode((GPIO_pin_t) -_sr_pins[color], OUTPUT);
-	    pinMode(_sr_pins[DATA], OUTPUT);
-	    pinMode(_sr_pins[CLK], OUTPUT);
-	    digitalWrite((GPIO_pin_t) -_sr_pins[color], LOW);
-	    for (uint8_t i = 0; i <= _num_rows; i++)
-	    {
-		digitalWrite(_sr_pins[CLK], LOW);
-		digitalWrite(_sr_pins[DATA], COL_OFF);
-		digitalWrite(_sr_pins[CLK], HIGH);
+	    while (1) {
+		Serial.println(F("RGB pins not on one port in DirectMatrix::beginHUB75"));
 	    }
-	    digitalWrite((GPIO_pin_t) -_sr_pins[color], HIGH);
 	}
-	else
+	mask |= GPIO_PIN_MASK(rgb_pins[i]);
+	pinMode(rgb_pins[i], OUTPUT);
+	digitalWrite(rgb_pins[i], LOW);
+    }
+    for (uint8_t i = 0; i < addr_lines; i++)
+    {
+	pinMode(addr_pins[i], OUTPUT);
+	digitalWrite(addr_pins[i], LOW);
+    }
+    for (uint8_t i = 0; i < 3; i++) pinMode(ctrl_pins[i], OUTPUT);
+    digitalWrite(ctrl_pins[HUB75_CLK], LOW);
+    digitalWrite(ctrl_pins[HUB75_LAT], LOW);
+    digitalWrite(ctrl_pins[HUB75_OE], HIGH);
+
+    // all off until the first writeDisplay()
+    if (! (DirectMatrix_HUB75_STEPS = (uint8_t *) calloc(lines * 4, _num_cols)))
+    {
+	while (1) {
+	    Serial.println(F("Malloc failed in DirectMatrix::beginHUB75"));
+	}
+    }
+    DirectMatrix_HUB75_DATA = rgb_pins[0];
+    DirectMatrix_HUB75_MASK = mask;
+    DirectMatrix_HUB75_PINS = ctrl_pins;
+    DirectMatrix_HUB75_ADDR_LINES = addr_lines;
+    DirectMatrix_HUB75 = 1;
+
+    _row_pins = addr_pins;
+    _col_pins = rgb_pins;
+    _sr_pins = ctrl_pins;
+    DirectMatrix_ROW_PINS = addr_pins;
+    DirectMatrix_COL_PINS[0] = rgb_pins;
+    // the ISR scans the lines, each lights 2 rows
+    DirectMatrix_ARRAY_ROWS = lines;
+    start(__ISR_freq);
+}
+
+// Append a step to the scan program, merged into the previous one when it
+// is on the same port and can be done in the same write: different bits,
+// at most one pixel test between the two, and not an edge that has to come
+// after the previous write (shift register clock and latch rising).
+static void DirectMatrix_ScanEmit(DirectMatrix_scan_op_t *program, 
+	uint16_t *len, uint8_t op, GPIO_pin_t pin, uint8_t lit, uint8_t dark,
+	uint8_t col, uint8_t edge) {
+    DirectMatrix_scan_op_t *prev = *len ? program + *len - 1 : NULL;
+    uint8_t mask = GPIO_PIN_MASK(pin);
+    uint8_t kind = op & 0x0F;
+
+    lit &= mask;
+    dark &= mask;
+    if (prev && ! edge && prev->port == (pin & 0xFF) && ! (prev->mask & mask) &&
+	kind <= DirectMatrix_OP_PIXEL && (prev->op & 0x0F) <= DirectMatrix_OP_PIXEL &&
+	! (kind == DirectMatrix_OP_PIXEL && 
+	   (prev->op & 0x0F) == DirectMatrix_OP_PIXEL))
+    {
+	if (kind == DirectMatrix_OP_PIXEL)
 	{
-	    pinMode(_sr_pins[color], OUTPUT);
-	    pinMode(_sr_pins[DATA], OUTPUT);
-	    pinMode(_sr_pins[CLK], OUTPUT);
-	    digitalWrite(_sr_pins[color], LOW);
-	    for (uint8_t i = 0; i <= _num_rows; i++)
-	    {
-		digitalWrite(_sr_pins[CLK], LOW);
-		digitalWrite(_sr_pins[DATA], COL_OFF);
-		digitalWrite(_sr_pins[CLK], HIGH);
-	    }
-	    digitalWrite(_sr_pins[color], HIGH);
+	    prev->op = op;
+	    prev->col = col;
 	}
+	prev->mask |= mask;
+	prev->lit |= lit;
+	prev->dark |= dark;
+	return;
     }
+    prev = program + *len;
+    prev->op = op;
+    prev->port = pin & 0xFF;
+    prev->mask = mask;
+    prev->lit = lit;
+    prev->dark = dark;
+    prev->col = col;
+    (*len)++;
+}
 
-    // We want at least 40Hz refresh at lowest intensity  
-    // x 8 rows x 16 levels of intensity -> 5120Hz or 195us
-    // I get good results by making the quickest interrupt be
-    // 150us, and 300, 600, 1200us for the other ones.
-    Timer1.initialize(DirectMatrix_ISR_FREQ[0]);
-    Timer1.attachInterrupt(DirectMatrix_RefreshPWMLine);
+// The scan program does what the column outputs do for the wiring given
+// to begin(), as port register writes, with the previous row going off
+// first and the new row on last. All the pin array lookups and wiring
+// tests happen here once. Only the auto, direct and (reversed) shift
+// register outputs can be compiled: with any other one, there is no
+// program and the ISR goes through the column outputs (returns 0).
+uint16_t DirectMatrix::compileScan(void) {
+    DirectMatrix_scan_op_t *program, *old_program;
+    uint8_t on = COL_ON ? 0xFF : 0;
+    uint16_t len = 0;
+
+    for (uint8_t color = 0; color < _num_colors; color++)
+    {
+	if (DirectMatrix_ScanKind(color) != DirectMatrix_SCAN_NONE) continue;
+	noInterrupts();
+	old_program = DirectMatrix_SCAN;
+	DirectMatrix_SCAN = NULL;
+	DirectMatrix_SCAN_LEN = 0;
+	interrupts();
+	if (old_program) free(old_program);
+	return 0;
+    }
+
+    // worst case: latch, clock low, data and clock high for each column,
+    // latch, for each color, and the 2 row steps
+    if (! (program = (DirectMatrix_scan_op_t *) malloc(
+	    (2 + _num_colors * (3 * _num_cols + 2)) * 
+	    sizeof(DirectMatrix_scan_op_t))))
+    {
+	while (1) {
+	    Serial.println(F("Malloc failed in DirectMatrix::compileScan"));
+	}
+    }
+
+    DirectMatrix_ScanEmit(program, &len, DirectMatrix_OP_OLD_ROW, DINV, 0, 0,
+			  0, 1);
+    for (uint8_t color = 0; color < _num_colors; color++)
+    {
+	uint8_t op = DirectMatrix_OP_PIXEL | (color << 4);
+	uint8_t kind = DirectMatrix_ScanKind(color);
+	GPIO_pin_t latch = _sr_pins[color];
+	uint8_t reversed;
+
+	// the same choice as DirectMatrix_AutoOutput
+	if (kind == DirectMatrix_SCAN_AUTO)
+	{
+	    if (latch == DINV) kind = DirectMatrix_SCAN_DIRECT;
+	    else if (latch > 32768) kind = DirectMatrix_SCAN_REVERSED_SR;
+	    else kind = DirectMatrix_SCAN_SR;
+	}
+	reversed = kind == DirectMatrix_SCAN_REVERSED_SR;
+	if (kind == DirectMatrix_SCAN_DIRECT)
+	{
+	    for (uint8_t col = 0; col < _num_cols; col++)
+		DirectMatrix_ScanEmit(program, &len, op, 
+				      DirectMatrix_COL_PINS[color][col], on, ~on,
+				      col, 0);
+	    continue;
+	}
+	if (reversed) latch = (GPIO_pin_t) -latch;
+	DirectMatrix_ScanEmit(program, &len, DirectMatrix_OP_WRITE, latch, 
+			      0, 0, 0, 0);
+	for (uint8_t i = 0; i < _num_cols; i++)
+	{
+	    uint8_t col = reversed ? _num_cols - 1 - i : i;
+	    DirectMatrix_ScanEmit(program, &len, DirectMatrix_OP_WRITE, 
+				  _sr_pins[CLK], 0, 0, 0, 0);
+	    DirectMatrix_ScanEmit(program, &len, op, _sr_pins[DATA], on, ~on,
+				  col, 0);
+	    DirectMatrix_ScanEmit(program, &len, DirectMatrix_OP_WRITE, 
+				  _sr_pins[CLK], 0xFF, 0xFF, 0, 1);
+	}
+	DirectMatrix_ScanEmit(program, &len, DirectMatrix_OP_WRITE, latch, 
+			      0xFF, 0xFF, 0, 1);
+    }
+    DirectMatrix_ScanEmit(program, &len, DirectMatrix_OP_ROW, DINV, 0, 0, 0,
+			  1);
+
+    // The ISR runs the old program until the pointer and the length are
+    // switched together, only then can it go.
+    program = (DirectMatrix_scan_op_t *) realloc(program,
+	len * sizeof(DirectMatrix_scan_op_t));
+    noInterrupts();
+    old_program = DirectMatrix_SCAN;
+    DirectMatrix_SCAN = program;
+    DirectMatrix_SCAN_LEN = len;
+    interrupts();
+    if (old_program) free(old_program);
+    return len;
+}
+
+// Build the RGB port bits of each line and plane from the framebuffer. The
+// first column shifted in ends up at the far end of the panel, so columns
+// go from the last one.
+void DirectMatrix::compileHUB75(void) {
+    // A step rewritten while the ISR shows it only glitches for one slot.
+    for (uint8_t line = 0; line < _num_rows / 2; line++)
+	for (uint8_t plane = 0; plane < 4; plane++)
+	    compileHUB75Step(line, plane, DirectMatrix_HUB75_STEPS);
 }
 
+// The RGB port bits of one line and plane, into steps
+void DirectMatrix::compileHUB75Step(uint8_t line, uint8_t plane,
+				    volatile uint8_t *steps) {
+    uint16_t *top = _matrix + line * _num_cols;
+    uint16_t *bottom = top + _num_rows / 2 * _num_cols;
+    volatile uint8_t *step = steps + (line * 4 + plane) * _num_cols;
+    uint8_t bits[6];
+
+    for (uint8_t i = 0; i < 6; i++) bits[i] = GPIO_PIN_MASK(_col_pins[i]);
+    for (uint8_t i = 0; i < _num_cols; i++)
+    {
+	uint8_t col = _num_cols - 1 - i;
+	uint16_t p1 = (top[col] & DirectMatrix_SHOWN) >> plane;
+	uint16_t p2 = (bottom[col] & DirectMatrix_SHOWN) >> plane;
+	uint8_t value = 0;
+
+	for (uint8_t color = 0; color < 3; color++)
+	{
+	    if (p1 & (1 << (color * 4))) value |= bits[color];
+	    if (p2 & (1 << (color * 4))) value |= bits[color + 3];
+	}
+	step[i] = value;
+    }
+}
+
+// Step n of the frame (row or line n / 4, plane n % 4), for the ISR
+void DirectMatrix::compileStep(uint16_t n, volatile uint8_t *steps) {
+    if (DirectMatrix_CHARLIE) compileCharlieStep(n >> 2, n & 3, steps);
+    else compileHUB75Step(n >> 2, n & 3, steps);
+}
+
+// Spread the compilation of charlieplexed and HUB75 frames over the
+// refresh: writeDisplay() only queues the frame, and each ISR run compiles
+// steps (row or line, plane) of it into a second buffer after lighting its
+// row, then the ISR shows the new frame once it is complete. The main loop
+// no longer stalls for the whole frame in writeDisplay() (milliseconds on
+// a 32x16 panel), each ISR takes longer instead (see ISR_runtime(), and
+// keep under the ISR budget). With 1 step, a frame takes one refresh
+// frame to show; compiling() tells how many steps are left. Drawing while
+// they are compiled mixes the frames, a writeDisplay() restarts the
+// compilation. Costs a second buffer of compiled planes (rows / 2 * 4 *
+// cols bytes for HUB75). 0 steps (the default) compiles in writeDisplay().
+// Call after beginCharlie()/beginHUB75(). Row/column matrices are shown
+// straight from the frame buffer and have nothing to compile.
+void DirectMatrix::backgroundCompile(uint8_t steps) {
+    volatile uint8_t *buf;
+    uint16_t size = 0;
+
+    if (DirectMatrix_CHARLIE) 
+	size = _num_rows * 4 * DirectMatrix_CHARLIE_PORTS * 2;
+    if (DirectMatrix_HUB75) size = _num_rows / 2 * 4 * _num_cols;
+
+    noInterrupts();
+    DirectMatrix_COMPILE_STEPS = 0;
+    DirectMatrix_COMPILE_END = DirectMatrix_COMPILE_POS = 0;
+    buf = DirectMatrix_COMPILE_BUF;
+    DirectMatrix_COMPILE_BUF = NULL;
+    interrupts();
+    if (buf) free((void *) buf);
+    if (! steps || ! size) return;
+
+    if (! (buf = (uint8_t *) malloc(size)))
+    {
+	while (1) {
+	    Serial.println(F("Malloc failed in DirectMatrix::backgroundCompile"));
+	}
+    }
+    noInterrupts();
+    DirectMatrix_COMPILER = this;
+    DirectMatrix_COMPILE_BUF = buf;
+    DirectMatrix_COMPILE_STEPS = steps;
+    interrupts();
+}
+
+// Steps of the last frame given to writeDisplay() left to compile, 0 once
+// it is shown
+uint16_t DirectMatrix::compiling(void) {
+    uint16_t left;
+
+    noInterrupts();
+    left = DirectMatrix_COMPILE_END - DirectMatrix_COMPILE_POS;
+    interrupts();
+    return left;
+}
+#endif
+
+// Scan a key matrix on the row lines: sense_pins are inputs, one per key
+// column, and key (row, i) connects row pin row to sense_pins[i] (with a
+// diode towards the row, so that several pressed keys don't short rows
+// together). Keys are read by the refresh ISR at the end of each row slot,
+// nothing else needs to run. Rows are active low for common cathode
+// matrices, the sense inputs then use the internal pull ups. For common
+// anode (active high rows), add external pull downs.
+// Up to 8 sense pins, key numbers are row * num_sense + i, below 128 (see
+// DirectMatrix_KEY_PRESSED). The scan keeps running when nothing is lit.
+void DirectMatrix::keys(GPIO_pin_t sense_pins[], uint8_t num_sense) {
+    uint8_t *state;
+
+    if (num_sense > 8) num_sense = 8;
+    if (_num_rows * num_sense > 128)
+    {
+	while (1) {
+	    Serial.println(F("More than 128 keys in DirectMatrix::keys"));
+	}
+    }
+    if (! (state = (uint8_t *) calloc(_num_rows, 3)))
+    {
+	while (1) {
+	    Serial.println(F("Malloc failed in DirectMatrix::keys"));
+	}
+    }
+    for (uint8_t i = 0; i < num_sense; i++)
+	pinMode(sense_pins[i], (ROW_ON == LOW) ? INPUT_PULLUP : INPUT);
+
+    noInterrupts();
+    DirectMatrix_NUM_KEYS = 0;
+    if (DirectMatrix_KEY_RAW) free((void *) DirectMatrix_KEY_RAW);
+    DirectMatrix_KEY_RAW = state;
+    DirectMatrix_KEY_COUNT = state + _num_rows;
+    DirectMatrix_KEY_STATE = state + 2 * _num_rows;
+    DirectMatrix_KEY_PINS = sense_pins;
+    DirectMatrix_KEY_HEAD = DirectMatrix_KEY_TAIL = 0;
+    DirectMatrix_NUM_KEYS = num_sense;
+    interrupts();
+    // in case the display was stopped because it is blank
+    writeDisplay();
+}
+
+// Next key event, or -1 if there is none: the key number, ORed with
+// DirectMatrix_KEY_PRESSED for a press.
+int16_t DirectMatrix::readKey(void) {
+    uint8_t event;
+
+    if (DirectMatrix_KEY_TAIL == DirectMatrix_KEY_HEAD) return -1;
+    event = DirectMatrix_KEY_EVENTS[DirectMatrix_KEY_TAIL];
+    DirectMatrix_KEY_TAIL = (DirectMatrix_KEY_TAIL + 1) & 
+			    (DirectMatrix_KEY_QUEUE - 1);
+    return event;
+}
+
+// Debounced state of a key, 1 if it is held
+uint8_t DirectMatrix::keyDown(uint8_t key) {
+    if (! DirectMatrix_NUM_KEYS) return 0;
+    uint8_t row = key / DirectMatrix_NUM_KEYS;
+    if (row >= _num_rows) return 0;
+    return (DirectMatrix_KEY_STATE[row] >> (key % DirectMatrix_NUM_KEYS)) & 1;
+}
+
+// Events dropped because readKey() was not called often enough
+uint16_t DirectMatrix::keysLost(void) {
+    uint16_t lost;
+
+    noInterrupts();
+    lost = DirectMatrix_KEY_LOST;
+    interrupts();
+    return lost;
+}
+
+// DirectMatrix uses a timer to keep the display updated, so there is nothing
+// to send to a row/column matrix here: the ISR shows the framebuffer as it
+// is drawn, whether writeDisplay() is called or not. Charlieplexed and
+// HUB75 panels show a frame compiled from the framebuffer here (or in the
+// background, see backgroundCompile()), drawing shows on them only after
+// writeDisplay(). For those compiled frames, and for row/column matrices
+// with adaptiveScan(1), this is also where we find out what was drawn:
+// - if nothing is lit, stop the timer and turn all the rows off until the
+//   next writeDisplay() with something to show.
+// - if all LEDs are full on or off, the 4 BCM planes are the same and the
+//   ISR only scans one of them at the slowest rate.
 void DirectMatrix::writeDisplay(void) {
-    // DirectMatrix uses a timer to keep the display updated
+    uint16_t lit = 0;
+    uint16_t mixed = 0;
+    uint8_t adaptive = DirectMatrix_ADAPTIVE_SCAN;
+
+#ifdef FASTIO
+    if (DirectMatrix_CHARLIE || DirectMatrix_HUB75) adaptive = 1;
+#endif
+    if (! adaptive)
+    {
+	// scan everything, drawing without writeDisplay() can't be seen here
+	lit = mixed = 1;
+    }
+    else for (uint16_t i = 0; i < _num_rows * _num_cols; i++)
+    {
+	uint16_t pixel = _matrix[i] & DirectMatrix_SHOWN;
+	lit |= pixel;
+	// a 4 bit color value is 0 or 15 iff its 4 bits are all the same
+	mixed |= (pixel ^ (pixel >> 1)) & 0x777;
+    }
+
+#ifdef FASTIO
+    // the ISR can only compile in the background while it runs
+    if (DirectMatrix_COMPILE_STEPS && ! DirectMatrix_SUSPENDED)
+    {
+	noInterrupts();
+	DirectMatrix_COMPILE_SINGLE = ! mixed;
+	DirectMatrix_COMPILE_POS = 0;
+	DirectMatrix_COMPILE_END = DirectMatrix_CHARLIE ? _num_rows * 4 : 
+						          _num_rows / 2 * 4;
+	interrupts();
+    }
+    else
+    {
+	noInterrupts();
+	DirectMatrix_COMPILE_END = DirectMatrix_COMPILE_POS = 0;
+	DirectMatrix_SINGLE_PLANE = ! mixed;
+	interrupts();
+	if (DirectMatrix_CHARLIE) compileCharlie();
+	if (DirectMatrix_HUB75) compileHUB75();
+    }
+#else
+    DirectMatrix_SINGLE_PLANE = ! mixed;
+#endif
+
+    // keep scanning the rows for the keys even if nothing is lit
+    if (! lit && ! DirectMatrix_NUM_KEYS)
+    {
+	if (DirectMatrix_SUSPENDED) return;
+	Timer1.stop();
+	DirectMatrix_SUSPENDED = 1;
+#ifdef FASTIO
+	if (DirectMatrix_CHARLIE)
+	{
+	    for (uint8_t i = 0; i < _num_rows; i++) pinMode(_row_pins[i], INPUT);
+	    return;
+	}
+	if (DirectMatrix_HUB75)
+	{
+	    digitalWrite(_sr_pins[HUB75_OE], HIGH);
+	    return;
+	}
+#endif
+	for (uint8_t i = 0; i < _num_rows; i++)
+	{
+	    digitalWrite(_row_pins[i], ROW_OFF);
+	}
+    }
+    else if (DirectMatrix_SUSPENDED)
+    {
+	DirectMatrix_SUSPENDED = 0;
+	// don't count the time we were stopped in the frame time
+	DirectMatrix_FRAME_START = micros();
+	// releaseWindow() will restart the timer if a window is held
+	if (! DirectMatrix_RESERVED) Timer1.resume();
+    }
+}
+
+// Have writeDisplay() stop the scan on dark frames and scan one plane of
+// on/off frames of a row/column matrix (off by default). The sketch must
+// then call writeDisplay() after each frame it draws: pixels drawn after a
+// dark or on/off frame don't show, or show without their levels, until it
+// does. adaptiveScan(0) scans everything again.
+void DirectMatrix::adaptiveScan(uint8_t enable) {
+    DirectMatrix_ADAPTIVE_SCAN = enable;
+    writeDisplay();
 }
 
 void DirectMatrix::clear(void) {
-  for (uint8_t i=0; i<_num_rows * _num_cols; i++) {
-    DirectMatrix_MATRIX[i] = 0;
+  for (uint16_t i=0; i<_num_rows * _num_cols; i++) {
+    _matrix[i] = 0;
   }
 }
 
+// Copy cols() colors to row y
+void DirectMatrix::writeRow(uint8_t y, const uint16_t *colors) {
+    memcpy(row(y), colors, _num_cols * sizeof(uint16_t));
+}
+
 uint32_t DirectMatrix::ISR_runtime(void) {
   return DirectMatrix_ISR_runtime;
 }
@@ -293,35 +1543,398 @@ uint32_t DirectMatrix::ISR_latency(void) {
   return DirectMatrix_ISR_latency;
 }
 
+// Percentage of the CPU used by the refresh ISR, averaged over the last few
+// frames. This is measured from inside the ISR, so it does not include the
+// interrupt entry/exit and TimerOne dispatch overhead (a few us per call).
+uint8_t DirectMatrix::cpuLoad(void) {
+    uint32_t busy, total;
+
+    if (DirectMatrix_SUSPENDED) return 0;
+    noInterrupts();
+    busy = DirectMatrix_FRAME_BUSY;
+    total = DirectMatrix_FRAME_TIME;
+    interrupts();
+    if (! total) return 0;
+    return busy * 100 / total;
+}
+
+// How many microseconds per frame are left to loop() once the refresh ISR
+// has run. Use with frameTime() to know how much work fits in a frame.
+uint32_t DirectMatrix::slackPerFrame(void) {
+    uint32_t busy, total;
+
+    noInterrupts();
+    busy = DirectMatrix_FRAME_BUSY;
+    total = DirectMatrix_FRAME_TIME;
+    interrupts();
+    if (DirectMatrix_SUSPENDED) return total;
+    return total - busy;
+}
+
+uint32_t DirectMatrix::frameTime(void) {
+    uint32_t total;
+
+    noInterrupts();
+    total = DirectMatrix_FRAME_TIME;
+    interrupts();
+    return total;
+}
+
+// Enable or disable automatic quality degradation on ISR overruns (off by
+// default, see DirectMatrix_AUTO_DEGRADE_DEFAULT). Either way, this
+// restores full quality.
+void DirectMatrix::autoDegrade(uint8_t enable) {
+    uint32_t base = DirectMatrix_ISR_BASE;
+
+    noInterrupts();
+    DirectMatrix_AUTO_DEGRADE = enable;
+    DirectMatrix_QUALITY = 0;
+    DirectMatrix_QUALITY_CHANGED = 0;
+    DirectMatrix_MIN_PLANE = 0;
+    DirectMatrix_ISR_FREQ[0] = base;
+    DirectMatrix_ISR_FREQ[1] = base << 1;
+    DirectMatrix_ISR_FREQ[2] = base << 2;
+    DirectMatrix_ISR_FREQ[3] = base << 3;
+    interrupts();
+}
+
+// Ghosting suppression. With slow row drivers, the previous row is still
+// on for a moment when the new columns are set and shows them faintly;
+// with slow column drivers (or shift register outputs with a lot of
+// capacitance), the new row briefly shows the previous row's columns.
+// deadTime() waits us microseconds (0 to 255, 0 by default) between the old
+// row going off and the new columns, preBlank(1) turns all the columns off
+// before the old row goes off. Both happen inside the ISR and the timer
+// period does not change, so they make each run longer: dead time by us,
+// pre-blank by one extra column write per color and row (a shift register
+// color costs a full shift out), which about doubles the ISR runtime. If
+// that no longer fits the slots, the ISR overruns them and the frames take
+// longer: raise the base period given to begin() to absorb it, or enable
+// autoDegrade(). preBlank(1) checks this against the last ISR run, counts
+// an overrun at once (see ISR_overruns()) and returns 0 when the shortest
+// slot in use can't take it. extras/host/scan_ghost measures the ghosting
+// left for given driver delays, and the ISR cost of each option.
+void DirectMatrix::deadTime(uint8_t us) {
+    DirectMatrix_DEAD_TIME = us;
+}
+
+uint8_t DirectMatrix::preBlank(uint8_t enable) {
+    uint8_t plane = DirectMatrix_MIN_PLANE;
+    uint8_t fits = 1;
+
+    if (plane < DirectMatrix_DEPTH_PLANE) plane = DirectMatrix_DEPTH_PLANE;
+    if (DirectMatrix_SINGLE_PLANE) plane = 3;
+    noInterrupts();
+    // The column writes are most of the ISR, pre-blank doubles them
+    if (enable && ! DirectMatrix_PRE_BLANK &&
+	DirectMatrix_ISR_runtime * 2 * 100 >
+	DirectMatrix_ISR_FREQ[plane] * DirectMatrix_ISR_BUDGET)
+    {
+	DirectMatrix_ISR_OVERRUNS++;
+	fits = 0;
+    }
+    DirectMatrix_PRE_BLANK = enable;
+    interrupts();
+    return fits;
+}
+
+// 0 is full quality, see DirectMatrix_Degrade() for the other levels.
+uint8_t DirectMatrix::quality(void) {
+    return DirectMatrix_QUALITY;
+}
+
+// Returns 1 once after each automatic quality change.
+uint8_t DirectMatrix::qualityChanged(void) {
+    uint8_t changed;
+
+    noInterrupts();
+    changed = DirectMatrix_QUALITY_CHANGED;
+    DirectMatrix_QUALITY_CHANGED = 0;
+    interrupts();
+    return changed;
+}
+
+uint32_t DirectMatrix::ISR_overruns(void) {
+    uint32_t overruns;
+
+    noInterrupts();
+    overruns = DirectMatrix_ISR_OVERRUNS;
+    interrupts();
+    return overruns;
+}
+
+#if DirectMatrix_TRACE
+// Binary dump of the trace buffer, oldest event first:
+// "DMTR", version (1), event size (6), event count (uint16), then the
+// events as in DirectMatrix_trace_t, all little endian.
+// The buffer is emptied once dumped.
+void DirectMatrix::traceDump(Print &out) {
+    uint16_t count;
+    uint16_t pos;
+
+    DirectMatrix_TRACE_PAUSED = 1;
+    count = DirectMatrix_TRACE_COUNT;
+    pos = (DirectMatrix_TRACE_POS + DirectMatrix_TRACE - count) % 
+	DirectMatrix_TRACE;
+
+    out.write((const uint8_t *) "DMTR", 4);
+    out.write(1);
+    out.write(sizeof(DirectMatrix_trace_t));
+    out.write(count & 0xFF);
+    out.write(count >> 8);
+    while (count--)
+    {
+	out.write((const uint8_t *) &DirectMatrix_TRACE_BUF[pos], 
+	    sizeof(DirectMatrix_trace_t));
+	if (++pos >= DirectMatrix_TRACE) pos = 0;
+    }
+
+    DirectMatrix_TRACE_COUNT = 0;
+    DirectMatrix_TRACE_PAUSED = 0;
+}
+#endif
+
+// Microseconds until the next refresh interrupt (0 if it is due now).
+// Returns 0xFFFFFFFF while the scan is suspended (nothing lit).
+// This is estimated from the ISR entry time, so keep a few us of margin.
+uint32_t DirectMatrix::nextRefresh(void) {
+    int32_t left;
+
+    if (DirectMatrix_SUSPENDED || DirectMatrix_RESERVED) return 0xFFFFFFFF;
+    noInterrupts();
+    left = DirectMatrix_ISR_NEXT - micros();
+    interrupts();
+    return (left > 0) ? left : 0;
+}
+
+// Guarantee that no refresh interrupt will fire for the next us
+// microseconds, for bit banged protocols (WS2812, one wire...) that cannot
+// be interrupted. If the current slot is too short, the timer is stopped
+// and the current row stays lit until releaseWindow() is called. That extra
+// on time is taken back from the same row's next slots, so its brightness
+// stays right on average.
+// Always call releaseWindow() when done, it is a no-op if nothing was held.
+void DirectMatrix::reserveWindow(uint16_t us) {
+    int32_t left;
+
+    noInterrupts();
+    left = DirectMatrix_ISR_NEXT - micros();
+    if (DirectMatrix_SUSPENDED || DirectMatrix_RESERVED || left > us)
+    {
+	interrupts();
+	return;
+    }
+    Timer1.stop();
+    DirectMatrix_RESERVED = 1;
+    DirectMatrix_RESERVE_START = micros();
+    interrupts();
+}
+
+void DirectMatrix::releaseWindow(void) {
+    uint32_t stretch;
+
+    noInterrupts();
+    if (! DirectMatrix_RESERVED)
+    {
+	interrupts();
+	return;
+    }
+    DirectMatrix_RESERVED = 0;
+    stretch = micros() - DirectMatrix_RESERVE_START;
+    DirectMatrix_ISR_NEXT += stretch;
+    // We only keep track of one row, drop older debt for another row.
+    if (DirectMatrix_DEBT_ROW != DirectMatrix_ROW) DirectMatrix_DEBT = 0;
+    DirectMatrix_DEBT_ROW = DirectMatrix_ROW;
+    DirectMatrix_DEBT += stretch;
+    if (! DirectMatrix_SUSPENDED) Timer1.resume();
+    interrupts();
+}
+
+// Put the CPU in idle sleep until the next interrupt (refresh ISR, millis
+// timer, serial...). Timers keep running in SLEEP_MODE_IDLE so the display
+// is not affected, we only save what the CPU core would burn spinning.
+void DirectMatrix::idle(void) {
+#ifdef __AVR__
+    set_sleep_mode(SLEEP_MODE_IDLE);
+    cli();
+    DirectMatrix_IDLE_START = micros();
+    DirectMatrix_SLEEPING = 1;
+    sleep_enable();
+    // sei() delays interrupts by one instruction, so we are guaranteed to
+    // reach sleep_cpu() before any pending interrupt can wake us.
+    sei();
+    sleep_cpu();
+    sleep_disable();
+    // Woken up by something else than the refresh ISR
+    cli();
+    if (DirectMatrix_SLEEPING)
+    {
+	DirectMatrix_idle_time += micros() - DirectMatrix_IDLE_START;
+	DirectMatrix_SLEEPING = 0;
+    }
+    sei();
+#else
+    yield();
+#endif
+}
+
+// Power aware delay(): sleeps between interrupts instead of spinning.
+void DirectMatrix::idleDelay(uint32_t ms) {
+    uint32_t start = micros();
+    uint32_t us = ms * 1000;
+
+    while (micros() - start < us) idle();
+}
+
+// Total time in microseconds spent sleeping in idle() (wraps after ~71mn).
+uint32_t DirectMatrix::idle_time(void) {
+    uint32_t t;
+
+    noInterrupts();
+    t = DirectMatrix_idle_time;
+    interrupts();
+    return t;
+}
+
 // If common pins are cathode, set common to 0, otherwise 1.
 PWMDirectMatrix::PWMDirectMatrix(uint8_t rows, uint8_t cols, uint8_t colors, 
 		uint8_t common) : 
-    DirectMatrix(rows, cols, colors, common), Adafruit_GFX(rows, cols) {
+    DirectMatrix(rows, cols, colors, common), Adafruit_GFX(cols, rows) {
 }
 
 // Default is common cathode.
 PWMDirectMatrix::PWMDirectMatrix(uint8_t rows, uint8_t cols, uint8_t colors) : 
-    DirectMatrix(rows, cols, colors, 0), Adafruit_GFX(rows, cols) {
+    DirectMatrix(rows, cols, colors, 0), Adafruit_GFX(cols, rows) {
 }
 
+// x/y are in the rotated coordinates, so the bounds are width()/height()
 void PWMDirectMatrix::drawPixel(int16_t x, int16_t y, uint16_t color) {
-  if ((y < 0) || (y >= _num_rows)) return;
-  if ((x < 0) || (x >= _num_cols)) return;
-
-  switch (getRotation()) {
-  case 1:
-    swap(x, y);
-    x = _num_cols - x - 1;
-    break;
-  case 2:
-    x = _num_cols - x - 1;
-    y = _num_rows - y - 1;
-    break;
-  case 3:
-    swap(x, y);
-    y = _num_rows - y - 1;
-    break;
+  if ((y < 0) || (y >= _height)) return;
+  if ((x < 0) || (x >= _width)) return;
+
+  _matrix[pixelIndex(x, y, rotation)] = color;
+}
+
+void PWMDirectMatrix::snapshot(uint16_t *buf) {
+  if (! rotation) {
+    memcpy(buf, _matrix, _num_rows * _num_cols * sizeof(uint16_t));
+    return;
   }
+  for (int16_t y = 0; y < _height; y++)
+    for (int16_t x = 0; x < _width; x++)
+      *buf++ = _matrix[pixelIndex(x, y, rotation)];
+}
+
+
+// ASCII 0x20-0x7F, bit n is column n of the segments (a = bit 0)
+static const uint8_t PROGMEM DirectSegments_font7[96] = {
+    0x00, 0x06, 0x22, 0x76, 0x6D, 0x24, 0x5F, 0x20, 0x39, 0x0F, 0x63, 0x70,
+    0x04, 0x40, 0x00, 0x52, 0x3F, 0x06, 0x5B, 0x4F, 0x66, 0x6D, 0x7D, 0x07,
+    0x7F, 0x6F, 0x00, 0x00, 0x58, 0x48, 0x4C, 0x53, 0x5B, 0x77, 0x7C, 0x39,
+    0x5E, 0x79, 0x71, 0x3D, 0x76, 0x30, 0x1E, 0x75, 0x38, 0x37, 0x54, 0x3F,
+    0x73, 0x67, 0x50, 0x6D, 0x78, 0x3E, 0x1C, 0x7E, 0x76, 0x6E, 0x5B, 0x39,
+    0x64, 0x0F, 0x23, 0x08, 0x02, 0x77, 0x7C, 0x58, 0x5E, 0x79, 0x71, 0x3D,
+    0x74, 0x10, 0x1E, 0x75, 0x38, 0x37, 0x54, 0x5C, 0x73, 0x67, 0x50, 0x6D,
+    0x78, 0x1C, 0x1C, 0x7E, 0x76, 0x6E, 0x5B, 0x79, 0x30, 0x4F, 0x01, 0x00,
+};
+
+static const uint16_t PROGMEM DirectSegments_font14[96] = {
+    0x0000, 0x0006, 0x0220, 0x12CE, 0x12ED, 0x0CE4, 0x2359, 0x0200,
+    0x2400, 0x0900, 0x3FC0, 0x12C0, 0x0800, 0x00C0, 0x0000, 0x0C00,
+    0x0C3F, 0x0406, 0x00DB, 0x008F, 0x00E6, 0x00ED, 0x00FD, 0x0007,
+    0x00FF, 0x00EF, 0x1200, 0x0A00, 0x2400, 0x00C8, 0x0900, 0x1083,
+    0x02BB, 0x00F7, 0x128F, 0x0039, 0x120F, 0x0079, 0x0071, 0x00BD,
+    0x00F6, 0x1209, 0x001E, 0x2470, 0x0038, 0x0536, 0x2136, 0x003F,
+    0x00F3, 0x203F, 0x20F3, 0x00ED, 0x1201, 0x003E, 0x0C30, 0x2836,
+    0x2D00, 0x1500, 0x0C09, 0x0039, 0x2100, 0x000F, 0x2800, 0x0008,
+    0x0100, 0x00F7, 0x128F, 0x0039, 0x120F, 0x0079, 0x0071, 0x00BD,
+    0x00F6, 0x1209, 0x001E, 0x2470, 0x0038, 0x0536, 0x2136, 0x003F,
+    0x00F3, 0x203F, 0x20F3, 0x00ED, 0x1201, 0x003E, 0x0C30, 0x2836,
+    0x2D00, 0x1500, 0x0C09, 0x2440, 0x1200, 0x0980, 0x00C0, 0x0000,
+};
+
+// Digits 0 to digits - 1 are rows first_row and up of the matrix, the ones
+// past its last row are dropped. The segments of a digit must fit in the
+// columns from first_col.
+DirectSegments::DirectSegments(DirectMatrix *matrix, uint8_t first_row, 
+	uint8_t digits, uint8_t segments, uint8_t first_col) {
+    if (first_col + segments > matrix->_num_cols)
+    {
+	while (1) {
+	    Serial.println(F("Too many columns in DirectSegments::DirectSegments"));
+	}
+    }
+    if (first_row >= matrix->_num_rows) digits = 0;
+    else if (first_row + digits > matrix->_num_rows)
+	digits = matrix->_num_rows - first_row;
+
+    _matrix = matrix;
+    _first_row = first_row;
+    _digits = digits;
+    _segments = segments;
+    _first_col = first_col;
+    _cursor = 0;
+    _color = LED_RED_HIGH;
+}
+
+// Value (intensity or color) of the lit segments
+void DirectSegments::setColor(uint16_t color) {
+    _color = color;
+}
+
+void DirectSegments::setCursor(uint8_t digit) {
+    _cursor = digit;
+}
+
+void DirectSegments::clear(void) {
+    for (uint8_t digit = 0; digit < _digits; digit++) writeDigitRaw(digit, 0);
+    _cursor = 0;
+}
+
+// Light the segments set in bits (bit 0 is segment a)
+void DirectSegments::writeDigitRaw(uint8_t digit, uint16_t bits) {
+    if (digit >= _digits) return;
+    uint16_t *pixel = _matrix->_matrix + (_first_row + digit) * 
+		      _matrix->_num_cols + _first_col;
+
+    for (uint8_t segment = 0; segment < _segments; segment++)
+	pixel[segment] = ((bits >> segment) & 1) ? _color : 0;
+}
 
-  DirectMatrix_MATRIX[y * _num_cols + x] = color;
+void DirectSegments::writeDisplay(void) {
+    _matrix->writeDisplay();
+}
+
+size_t DirectSegments::write(uint8_t c) {
+    uint8_t dp = _segments - 1;
+    uint16_t bits = 0;
+
+    if (c == '\n' || c == '\r')
+    {
+	_cursor = 0;
+	return 1;
+    }
+    if (c == '.' && _cursor > 0 && _cursor <= _digits)
+    {
+	uint16_t *pixel = _matrix->_matrix + (_first_row + _cursor - 1) * 
+			  _matrix->_num_cols + _first_col;
+	// "1.5": the dot goes on the 1, unless it already has one ("1..5")
+	if (! pixel[dp])
+	{
+	    pixel[dp] = _color;
+	    return 1;
+	}
+    }
+    if (_cursor >= _digits) return 0;
+
+    if (c == '.') bits = 1 << dp;
+    else if (c >= 0x20 && c < 0x80)
+    {
+	if (_segments == DirectSegments_14SEG) 
+	    bits = pgm_read_word(&DirectSegments_font14[c - 0x20]);
+	else
+	    bits = pgm_read_byte(&DirectSegments_font7[c - 0x20]);
+    }
+    writeDigitRaw(_cursor++, bits);
+    return 1;
 }
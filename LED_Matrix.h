@@ -1,3 +1,6 @@
+#ifndef LED_Matrix_h
+#define LED_Matrix_h
+
 #if (ARDUINO >= 100)
  #include "Arduino.h"
 #else
@@ -14,7 +17,11 @@
 // Include before the pinmode/digitalwrite below due to incompatible definitions
 #include "TimerOne.h"
 
+// Comment out (or build with -DNO_FASTIO) to use the stock Arduino
+// digitalWrite with integer pin numbers.
+#ifndef NO_FASTIO
 #define FASTIO
+#endif
 
 #ifdef FASTIO
 //include the fast I/O 2 functions 
@@ -29,6 +36,126 @@
 #endif
 
 #define DirectMatrix_PWM_LEVELS 16 // 4 bits done with 4 interrupts per line
+// An ISR run longer than this % of its slot counts as an overrun
+#ifndef DirectMatrix_ISR_BUDGET
+#define DirectMatrix_ISR_BUDGET 95
+#endif
+// Set to 1 to have frames with overruns lower the quality (see
+// autoDegrade()) without calling autoDegrade(1) from the sketch. Off by
+// default: the examples run close to the budget by design and would show
+// fewer levels.
+#ifndef DirectMatrix_AUTO_DEGRADE_DEFAULT
+#define DirectMatrix_AUTO_DEGRADE_DEFAULT 0
+#endif
+
+// Number of ISR events kept in the trace ring buffer, 0 disables tracing.
+// Each event uses 6 bytes of RAM (e.g. -DDirectMatrix_TRACE=64). Dump with
+// traceDump(Serial) and decode with extras/trace_decode.py
+#ifndef DirectMatrix_TRACE
+#define DirectMatrix_TRACE 0
+#endif
+
+// Key matrix scanning (see keys()): a change must be seen on this many
+// scans of its row in a row to count, and up to DirectMatrix_KEY_QUEUE - 1
+// events (power of 2) wait for readKey().
+#define DirectMatrix_KEY_DEBOUNCE 3
+#define DirectMatrix_KEY_QUEUE 16
+// Set in a readKey() event for a press, the key number is in the low 7
+// bits: keys() takes at most 128 keys (rows * sense pins).
+#define DirectMatrix_KEY_PRESSED 0x80
+
+// Charlieplexing needs FASTIO (port registers are written directly), the
+// pins can be spread over up to this many ports.
+#define DirectMatrix_CHARLIE_MAX_PORTS 4
+
+// Column output of each color, chosen at compile time so that the ISR only
+// has the code for the wiring in use (see the outputs in LED_Matrix.cpp):
+// - DirectMatrix_AutoOutput: any of the below, picked at runtime from the
+//   sr_pins given to begin() (default, works with every sketch)
+// - DirectMatrix_DirectOutput: one pin per column
+// - DirectMatrix_SROutput: shift register on DATA/CLK, latch in the
+//   color's sr_pins slot, column 0 shifted first
+// - DirectMatrix_ReversedSROutput: same, last column shifted first
+// - DirectMatrix_SPIOutput: shift register on the hardware SPI pins (DATA
+//   and CLK must be MOSI and SCK), column 0 shifted first
+// - DirectMatrix_MockOutput: no pins, the columns are stored in
+//   DirectMatrix_MOCK_COLS[color] (host tests and ISR timing), up to 32
+// They can also be given on the compiler command line, e.g.
+// -DDirectMatrix_COLOR2_OUTPUT=DirectMatrix_SPIOutput
+#ifndef DirectMatrix_COLOR1_OUTPUT
+#define DirectMatrix_COLOR1_OUTPUT DirectMatrix_AutoOutput
+#endif
+#ifndef DirectMatrix_COLOR2_OUTPUT
+#define DirectMatrix_COLOR2_OUTPUT DirectMatrix_AutoOutput
+#endif
+#ifndef DirectMatrix_COLOR3_OUTPUT
+#define DirectMatrix_COLOR3_OUTPUT DirectMatrix_AutoOutput
+#endif
+
+// Bit depth of each color, 0 to 4: a color is only shown in that many BCM
+// planes, the most significant ones, and its lower bits are ignored (a
+// depth of 2 gives levels 0, 4, 8 and 12). Pixels keep 4 bits per color so
+// the LED_ colors below work with any depth. Below its planes a color is
+// dark and the ISR only blanks its columns once per plane instead of
+// writing them for every row (the scan program still writes them, dark),
+// and planes where no color is shown are not scanned at all. Lower the
+// depth of a color that carries little detail to save its shift out time,
+// e.g. -DDirectMatrix_COLOR3_DEPTH=2 for 4-4-2.
+#ifndef DirectMatrix_COLOR1_DEPTH
+#define DirectMatrix_COLOR1_DEPTH 4
+#endif
+#ifndef DirectMatrix_COLOR2_DEPTH
+#define DirectMatrix_COLOR2_DEPTH 4
+#endif
+#ifndef DirectMatrix_COLOR3_DEPTH
+#define DirectMatrix_COLOR3_DEPTH 4
+#endif
+
+// Set to 1 (needs FASTIO) to have begin() compile the wiring into a scan
+// program, a flat list of port register writes run by the ISR for each
+// row, instead of going through the pin arrays and the column outputs
+// above. Only the Auto, Direct, SR and ReversedSR outputs are compiled: if
+// a color uses another one (SPI, Mock), there is no scan program and the
+// ISR uses the column outputs. extras/host/scan_asm disassembles it and
+// estimates its cycles.
+#ifndef DirectMatrix_SCAN_PROGRAM
+#define DirectMatrix_SCAN_PROGRAM 0
+#endif
+
+// HUB75 RGB panels (see DirectMatrix::beginHUB75()), slots of the control
+// pin array
+#define HUB75_CLK 0
+#define HUB75_LAT 1
+#define HUB75_OE 2
+
+#if DirectMatrix_TRACE
+struct DirectMatrix_trace_t {
+  uint16_t time;	// low 16 bits of micros() at ISR entry
+  uint8_t row;		// row lit by this ISR
+  uint8_t plane;	// BCM plane (0-3)
+  uint16_t runtime;	// ISR runtime in us
+};
+#endif
+#ifdef FASTIO
+// One scan program step: PORT = (PORT & ~mask) | value, where value is lit
+// or dark depending on the pixel in column col of the row for the color in
+// the high nibble of op (DirectMatrix_OP_PIXEL), always lit
+// (DirectMatrix_OP_WRITE), or the previous/current row pin going off/on
+// (DirectMatrix_OP_OLD_ROW/DirectMatrix_OP_ROW, port and mask unused).
+#define DirectMatrix_OP_WRITE 0
+#define DirectMatrix_OP_PIXEL 1
+#define DirectMatrix_OP_OLD_ROW 2
+#define DirectMatrix_OP_ROW 3
+struct DirectMatrix_scan_op_t {
+  uint8_t op;
+  uint8_t port;		// PORTx, low byte of the pin codes
+  uint8_t mask;
+  uint8_t lit;
+  uint8_t dark;
+  uint8_t col;
+};
+#endif
+
 #define LED_RED_VERYLOW 	1
 #define LED_RED_LOW 		3
 #define LED_RED_MEDIUM 		7
@@ -73,25 +200,115 @@
 #define CLK 4
 
 class DirectMatrix {
+  friend class DirectSegments;
  public:
   DirectMatrix(uint8_t, uint8_t, uint8_t, uint8_t);
+  // Stops the refresh if this is the matrix shown, see LED_Matrix.cpp
+  ~DirectMatrix();
   void begin(GPIO_pin_t [], GPIO_pin_t [], GPIO_pin_t [], uint32_t);
+  // Same with the pin arrays in PROGMEM, they are copied once and don't
+  // need to be kept around.
+  void begin_P(const GPIO_pin_t [], const GPIO_pin_t [], const GPIO_pin_t [],
+	       uint32_t);
+#ifdef FASTIO
+  // Charlieplexed LEDs on n pins instead of a row/column matrix, for a
+  // DirectMatrix(n, n - 1, 1, ...)
+  void beginCharlie(GPIO_pin_t [], uint32_t);
+  // HUB75 RGB panel (R1 G1 B1 R2 G2 B2, address lines, CLK/LAT/OE), for a
+  // DirectMatrix(rows, cols, 3, ...)
+  void beginHUB75(GPIO_pin_t [], GPIO_pin_t [], GPIO_pin_t [], uint32_t);
+  // Compile the row/column wiring given to begin() into the scan program,
+  // returns its number of steps, 0 if a color's output can't be compiled
+  // (begin() does it with DirectMatrix_SCAN_PROGRAM)
+  uint16_t compileScan(void);
+  // Compile charlieplexed and HUB75 frames this many steps per refresh
+  // interrupt instead of in writeDisplay() (0), see LED_Matrix.cpp;
+  // compiling() is the number of steps left before the last frame shows
+  void backgroundCompile(uint8_t);
+  uint16_t compiling(void);
+#endif
+  // Row/column matrices show the framebuffer as it is drawn, calling
+  // writeDisplay() is optional unless adaptiveScan(1). Charlieplexed and
+  // HUB75 panels only show what was drawn after writeDisplay().
   void writeDisplay(void);
+  // Let writeDisplay() suspend the scan on dark frames and scan on/off
+  // frames in one plane, see LED_Matrix.cpp
+  void adaptiveScan(uint8_t);
   void clear(void);
+  // The framebuffer a row at a time, in panel coordinates (no rotation):
+  // row(y)[x] is the color of column x in row y, for bulk writes and
+  // effects that compute whole rows (see LED_Effects.h). Bits 12-15 of a
+  // color are not displayed.
+  uint8_t rows(void) { return _num_rows; }
+  uint8_t cols(void) { return _num_cols; }
+  uint16_t *row(uint8_t y) { return _matrix + y * _num_cols; }
+  void writeRow(uint8_t, const uint16_t *);
   uint32_t ISR_runtime(void);
   uint32_t ISR_latency(void);
+  uint8_t cpuLoad(void);
+  uint32_t slackPerFrame(void);
+  uint32_t frameTime(void);
+  uint32_t nextRefresh(void);
+  void reserveWindow(uint16_t);
+  void releaseWindow(void);
+  void autoDegrade(uint8_t);
+  // Ghosting suppression, see LED_Matrix.cpp. Both lengthen the ISR,
+  // preBlank(1) returns 0 if it no longer fits the shortest slot.
+  void deadTime(uint8_t);
+  uint8_t preBlank(uint8_t);
+  uint8_t quality(void);
+  uint8_t qualityChanged(void);
+  uint32_t ISR_overruns(void);
+#if DirectMatrix_TRACE
+  void traceDump(Print &);
+#endif
   void init(uint8_t a);
+  // Sleep (SLEEP_MODE_IDLE) until the next interrupt, the refresh ISR keeps
+  // running. idleDelay is a delay() replacement built on top of it.
+  void idle(void);
+  void idleDelay(uint32_t);
+  uint32_t idle_time(void);
+  // Buttons sharing the row lines, read by the refresh ISR
+  void keys(GPIO_pin_t [], uint8_t);
+  int16_t readKey(void);
+  uint8_t keyDown(uint8_t);
+  uint16_t keysLost(void);
 
  protected:
   uint8_t _num_rows;
   uint8_t _num_cols;
   uint8_t _num_colors;
+  uint16_t *_matrix;
+
+  // Framebuffer offset of x/y (in range) in the rotated coordinates of the
+  // drawing classes, the panel is cols wide and rows high before rotation.
+  uint16_t pixelIndex(int16_t x, int16_t y, uint8_t rotation) {
+    switch (rotation) {
+    case 1: return x * _num_cols + _num_cols - 1 - y;
+    case 2: return (_num_rows - 1 - y) * _num_cols + _num_cols - 1 - x;
+    case 3: return (_num_rows - 1 - x) * _num_cols + y;
+    }
+    return y * _num_cols + x;
+  }
  
  private:
+  void begin_pins(GPIO_pin_t [], GPIO_pin_t [], GPIO_pin_t [], uint32_t,
+		  uint8_t);
+  void start(uint32_t);
+#ifdef FASTIO
+  void compileCharlie(void);
+  void compileCharlieStep(uint8_t, uint8_t, volatile uint8_t *);
+  void compileHUB75(void);
+  void compileHUB75Step(uint8_t, uint8_t, volatile uint8_t *);
+  // background compilation, called by the refresh ISR
+  void compileStep(uint16_t, volatile uint8_t *);
+  friend void DirectMatrix_RefreshPWMLine(void);
+#endif
   GPIO_pin_t *_row_pins;
   GPIO_pin_t *_col_pins;
   GPIO_pin_t *_sr_pins;
-  uint16_t *_matrix;
+  // rows, direct columns and sr pins copied by begin_P()
+  GPIO_pin_t *_pin_table;
 };
 
 class PWMDirectMatrix : public DirectMatrix, public Adafruit_GFX {
@@ -100,8 +317,56 @@ class PWMDirectMatrix : public DirectMatrix, public Adafruit_GFX {
   PWMDirectMatrix(uint8_t, uint8_t, uint8_t);
 
   void drawPixel(int16_t x, int16_t y, uint16_t color);
+  // Color of a pixel as given to drawPixel(), 0 outside of the display.
+  // Effects that read their neighbours (blur, fire, trails) can work in
+  // place instead of keeping a second framebuffer.
+  uint16_t getPixel(int16_t x, int16_t y) {
+    if ((uint16_t) x >= (uint16_t) _width) return 0;
+    if ((uint16_t) y >= (uint16_t) _height) return 0;
+    return _matrix[pixelIndex(x, y, rotation)];
+  }
+  // Copy of the display into width() * height() words, row by row in the
+  // rotated coordinates like getPixel (buf[y * width() + x]).
+  void snapshot(uint16_t *buf);
 
  private:
 };
 
+// Multiplexed 7 or 14 segment digits on the DirectMatrix scan: each digit
+// is a row (its common pin) and each segment a column, so they get the same
+// PWM and share the refresh ISR with a matrix wired on the same columns
+// (digits are then extra rows after the matrix rows).
+// Segment columns, from first_col:
+// 7 segments:  a b c d e f g dp
+// 14 segments: a b c d e f g1 g2 h j k l m n dp
+// (h j k: upper left diagonal, vertical, right diagonal, l m n: lower left
+//  diagonal, vertical, right diagonal)
+#define DirectSegments_7SEG 8
+#define DirectSegments_14SEG 15
+
+class DirectSegments : public Print {
+ public:
+  DirectSegments(DirectMatrix *, uint8_t, uint8_t, 
+		 uint8_t segments = DirectSegments_7SEG, uint8_t first_col = 0);
+  void setColor(uint16_t);
+  void setCursor(uint8_t);
+  void clear(void);
+  void writeDigitRaw(uint8_t, uint16_t);
+  void writeDisplay(void);
+  // print() goes through this: characters fill the digits from the cursor,
+  // '.' lights the decimal point of the previous digit and '\n' goes back
+  // to the first digit.
+  size_t write(uint8_t);
+  using Print::write;
+
+ private:
+  DirectMatrix *_matrix;
+  uint8_t _first_row;
+  uint8_t _digits;
+  uint8_t _segments;
+  uint8_t _first_col;
+  uint8_t _cursor;
+  uint16_t _color;
+};
 
+#endif
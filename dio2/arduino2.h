@@ -53,7 +53,8 @@ extern "C"{
 
 // Arduino compatible functions (slower, but take pin as an integer)
 // The pin is simple integer ( 0 thru 19).
-// Note: these functions are never compiled into single instruction, even with cont pin.
+// Note: with a const pin these compile into single instruction too, see
+// Arduino_to_GPIO_pin.
 static inline void pinMode2(uint8_t, uint8_t);
 static inline void digitalWrite2(uint8_t, uint8_t);
 static inline uint8_t digitalRead2(uint8_t);
@@ -341,6 +342,17 @@ void digitalWrite2f(GPIO_pin_t pin, uint8_t value)
 // This is used internally by inline function Arduino_to_GPIO_pin, which adds range check.
 #define		GPIO_GET_PINDEF(pin)  (GPIO_pin_t)pgm_read_word(gpio_pins_progmem + (pin))
 
+// Copy of gpio_pins_progmem for pin numbers known at compile time.
+// It is only ever read with const index, so the compiler computes the
+// result and the array itself does not end up in RAM or FLASH.
+#ifdef __cplusplus
+static constexpr GPIO_pin_t gpio_pins_const[] = { GPIO_PINS_LIST };
+#else
+static const GPIO_pin_t gpio_pins_const[] __attribute__((unused)) = { GPIO_PINS_LIST };
+#endif
+#define		GPIO_CONST_PINDEF(pin) \
+	(((pin) < GPIO_PINS_NUMBER) ? gpio_pins_const[(pin)] : DP_INVALID)
+
 //
 // Arduino_to_GPIO_pin
 //
@@ -361,10 +373,17 @@ void digitalWrite2f(GPIO_pin_t pin, uint8_t value)
 // automatically inline (make into single instruction) for const input. Since 
 // this seem impossible to achieve for me now, I use the array version of code and
 // inline function.
+// Update: the same __builtin_constant_p test as digitalWrite2f does it
+// without 2 copies of the code: const pins are looked up in the const copy
+// of the array (gpio_pins_const), which the compiler evaluates, so
+// digitalWrite2(13, HIGH) is single instruction. Other pins still read the
+// PROGMEM array.
 static inline GPIO_pin_t Arduino_to_GPIO_pin(uint8_t) __attribute__((always_inline, unused));
 static inline
 GPIO_pin_t Arduino_to_GPIO_pin(uint8_t pin)
 {
+	if ( __builtin_constant_p(pin) )
+		return GPIO_CONST_PINDEF(pin);
 	if ( pin < GPIO_PINS_NUMBER )
 		return GPIO_GET_PINDEF(pin);
 	else
@@ -378,6 +397,15 @@ GPIO_pin_t Arduino_to_GPIO_pin(uint8_t pin)
 
 #ifdef __cplusplus
 } // extern "C"
+
+// Pin code of Arduino pin number as constant expression (C++11), for where
+// the value must be known to the compiler, not just to the optimizer:
+// template arguments, case labels, constexpr tables...
+// GPIO_PIN(13) is DP13.
+constexpr GPIO_pin_t GPIO_PIN(uint8_t pin)
+{
+	return GPIO_CONST_PINDEF(pin);
+}
 #endif
 
 #endif /* ARDUINO2_H_ */
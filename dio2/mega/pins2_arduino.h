@@ -212,6 +212,24 @@ typedef	enum GPIO_pin_enum  GPIO_pin_t;
 // Used in Arduino_to_GPIO_pin
 #define		GPIO_PINS_NUMBER		(70)
 
+// The pin codes in Arduino pin number order: the gpio_pins_progmem array
+// below and the compile time lookup of constant pin numbers in arduino2.h
+#define		GPIO_PINS_LIST	\
+		DP0, DP1, DP2, DP3,	DP4, \
+		DP5, DP6, DP7, DP8, DP9, \
+		DP10, DP11, DP12, DP13, DP14, \
+		DP15, DP16, DP17, DP18, DP19, \
+		DP20, DP21, DP22, DP23, DP24, \
+		DP25, DP26, DP27, DP28,	DP29, \
+		DP30, DP31, DP32, DP33,	DP34, \
+		DP35, DP36, DP37, DP38,	DP39, \
+		DP40, DP41, DP42, DP43,	DP44, \
+		DP45, DP46, DP47, DP48,	DP49, \
+		DP50, DP51, DP52, DP53,	DP54, \
+		DP55, DP56, DP57, DP58,	DP59, \
+		DP60, DP61, DP62, DP63,	DP64, \
+		DP65, DP66, DP67, DP68,	DP69
+
 // Macro to obtain bit mask of a pin from its code
 #define		GPIO_PIN_MASK(pin)		((uint8_t)((uint16_t)pin >> 8))
 
@@ -242,20 +260,7 @@ typedef	enum GPIO_pin_enum  GPIO_pin_t;
 // The Arduino pin number is used as index into this array. Value at given index
 // N is the pin code for the Arduino pin N.
 const GPIO_pin_t PROGMEM gpio_pins_progmem[] = {
-		DP0, DP1, DP2, DP3,	DP4,
-		DP5, DP6, DP7, DP8, DP9,
-		DP10, DP11, DP12, DP13, DP14,
-		DP15, DP16, DP17, DP18, DP19,
-		DP20, DP21, DP22, DP23, DP24,
-		DP25, DP26, DP27, DP28,	DP29,
-		DP30, DP31, DP32, DP33,	DP34,
-		DP35, DP36, DP37, DP38,	DP39,
-		DP40, DP41, DP42, DP43,	DP44,
-		DP45, DP46, DP47, DP48,	DP49,
-		DP50, DP51, DP52, DP53,	DP54,
-		DP55, DP56, DP57, DP58,	DP59,
-		DP60, DP61, DP62, DP63,	DP64,
-		DP65, DP66, DP67, DP68,	DP69,
+		GPIO_PINS_LIST
 };
 #else
 	extern GPIO_pin_t PROGMEM gpio_pins_progmem[];
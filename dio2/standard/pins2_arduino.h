@@ -163,6 +163,15 @@ enum GPIO_pin_t
 */
 
 
+// The pin codes in Arduino pin number order: the gpio_pins_progmem array
+// below and the compile time lookup of constant pin numbers in arduino2.h
+#define		GPIO_PINS_LIST	\
+		DP0, DP1, DP2, DP3, \
+		DP4, DP5, DP6, DP7, \
+		DP8, DP9, DP10, DP11, \
+		DP12, DP13, DP14, DP15, \
+		DP16, DP17, DP18, DP19
+
 // Macro to obtain bit mask of a pin from its code
 #define		GPIO_PIN_MASK(pin)		((uint8_t)((uint16_t)pin >> 8))
 
@@ -186,11 +195,7 @@ enum GPIO_pin_t
 // The Arduino pin number is used as index into this array. Value at given index
 // N is the pin code for the Arduino pin N.
 const GPIO_pin_t PROGMEM gpio_pins_progmem[] = {
-		DP0, DP1, DP2, DP3,
-		DP4, DP5, DP6, DP7,
-		DP8, DP9, DP10, DP11,
-		DP12, DP13, DP14, DP15,
-		DP16, DP17, DP18, DP19,
+		GPIO_PINS_LIST
 };
 #else
 	const extern GPIO_pin_t PROGMEM gpio_pins_progmem[];
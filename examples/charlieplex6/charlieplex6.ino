@@ -0,0 +1,57 @@
+/*************************************************** 
+    Charlieplexing example: 6 pins drive 30 LEDs, with the same 16 levels
+    of PWM as the row/column matrices.
+    Each pin goes through a resistor to the LEDs, and between each pair
+    of pins there are 2 LEDs in opposite directions. Pixel (x, y) is the
+    LED with its anode on pins[y] and its cathode on the x-th other pin,
+    see DirectMatrix::beginCharlie().
+ ****************************************************/
+
+#include "LED_Matrix.h"
+
+// I shouldn't have to re-include these libs included in LED_Matrix.h
+#include <Wire.h>
+#include <Adafruit_GFX.h>
+#include <TimerOne.h>
+
+#ifndef FASTIO
+#error Charlieplexing needs FASTIO
+#endif
+
+#define NUM_PINS 6
+
+// Spread over 2 ports, any pins work
+GPIO_pin_t pins[NUM_PINS] = { DP4, DP5, DP6, DP7, DP8, DP9 };
+
+PWMDirectMatrix *matrix;
+
+void setup() {
+    // 6 rows (anodes) x 5 columns (the other pins), 1 color
+    matrix = new PWMDirectMatrix(NUM_PINS, NUM_PINS - 1, 1);
+    matrix->beginCharlie(pins, 200);
+}
+
+void loop() {
+    // all 16 levels, in LED order
+    matrix->clear();
+    for (uint8_t i = 0; i < NUM_PINS * (NUM_PINS - 1); i++)
+	matrix->drawPixel(i % (NUM_PINS - 1), i / (NUM_PINS - 1), i / 2);
+    // nothing shows until writeDisplay() with charlieplexing
+    matrix->writeDisplay();
+    matrix->idleDelay(3000);
+
+    // a dot with a fading tail going through all the LEDs
+    for (uint8_t i = 0; i < NUM_PINS * (NUM_PINS - 1) + 4; i++)
+    {
+	matrix->clear();
+	for (uint8_t t = 0; t < 4; t++)
+	{
+	    int8_t led = i - t;
+	    if (led < 0 || led >= NUM_PINS * (NUM_PINS - 1)) continue;
+	    matrix->drawPixel(led % (NUM_PINS - 1), led / (NUM_PINS - 1),
+			      LED_RED_HIGH >> t);
+	}
+	matrix->writeDisplay();
+	matrix->idleDelay(80);
+    }
+}
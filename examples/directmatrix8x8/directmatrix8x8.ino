@@ -124,10 +124,20 @@ static const uint16_t PROGMEM
 	0x00E, 0x00E, 0x00E, 0x00E, 0x00F, 0x00F, 0x00F, 0x00F, } };
 
 void show_isr() {
+    if (DEBUG && matrix->qualityChanged()) {
+	Serial.print  (F("ISR overruns, quality lowered to level "));
+	Serial.println(matrix->quality());
+    }
     if (DEBUG) Serial.print  (F("ISR runtime: "));
     if (DEBUG) Serial.print  (matrix->ISR_runtime());
     if (DEBUG) Serial.print  (F(" and latency: "));
-    if (DEBUG) Serial.println(matrix->ISR_latency());
+    if (DEBUG) Serial.print  (matrix->ISR_latency());
+    if (DEBUG) Serial.print  (F(" CPU load: "));
+    if (DEBUG) Serial.print  (matrix->cpuLoad());
+    if (DEBUG) Serial.print  (F("% slack per frame: "));
+    if (DEBUG) Serial.print  (matrix->slackPerFrame());
+    if (DEBUG) Serial.print  (F(" and idle time (ms): "));
+    if (DEBUG) Serial.println(matrix->idle_time() / 1000);
 }
 
 void loop() {
@@ -135,7 +145,7 @@ void loop() {
     matrix->clear();
     matrix->fillRect(0,0, 8,8, LED_RED_HIGH);
     matrix->writeDisplay();
-    delay(3000);
+    matrix->idleDelay(3000);
 
     for (uint8_t i=0; i<=0; i++)
     {
@@ -143,32 +153,32 @@ void loop() {
 	matrix->clear();
 	matrix->drawRGBBitmap(0, 0, RGB_bmp[i], 8, 8);
 	matrix->writeDisplay();
-	delay(4000);
+	matrix->idleDelay(4000);
     }
 
     show_isr();
     matrix->clear();
     matrix->drawBitmap(0, 0, smile_bmp, 8, 8, LED_RED_HIGH);
     matrix->writeDisplay();
-    delay(1000);
+    matrix->idleDelay(1000);
 
     show_isr();
     matrix->clear();
     matrix->drawBitmap(0, 0, neutral_bmp, 8, 8, LED_RED_MEDIUM);
     matrix->writeDisplay();
-    delay(1000);
+    matrix->idleDelay(1000);
 
     show_isr();
     matrix->clear();
     matrix->drawBitmap(0, 0, frown_bmp, 8, 8, LED_RED_LOW);
     matrix->writeDisplay();
-    delay(1000);
+    matrix->idleDelay(1000);
 
     show_isr();
     matrix->clear();
     matrix->drawCircle(3,3, 3, LED_RED_MEDIUM);
     matrix->writeDisplay();
-    delay(500);
+    matrix->idleDelay(500);
 
     matrix->setTextWrap(false);  // we don't wrap text so it scrolls nicely
     matrix->setTextSize(1);
@@ -179,9 +189,9 @@ void loop() {
         matrix->setCursor(x,0);
         matrix->print("Hello");
         matrix->writeDisplay();
-	delay(50);
+	matrix->idleDelay(50);
     }
-    delay(100);
+    matrix->idleDelay(100);
     matrix->setRotation(0);
     matrix->setTextColor(LED_RED_LOW);
     for (int8_t x=7; x>=-36; x--) {
@@ -189,7 +199,7 @@ void loop() {
         matrix->setCursor(x,0);
         matrix->print("World");
         matrix->writeDisplay();
-	delay(50);
+	matrix->idleDelay(50);
     }
     matrix->setRotation(0);
 }
@@ -33,12 +33,12 @@ PWMDirectMatrix *matrix;
 
 void setup() {
     // Turn on all the LEDs
-    for (uint8_t i = 0; i <= 8; i++)
+    for (uint8_t i = 0; i < 8; i++)
     {
 	pinMode(line_pins[i], OUTPUT);
 	digitalWrite(line_pins[i], LOW);
     }
-    for (uint8_t i = 0; i <= 8; i++)
+    for (uint8_t i = 0; i < 8; i++)
     {
 	pinMode(column_pins[i], OUTPUT);
 	digitalWrite(column_pins[i], HIGH);
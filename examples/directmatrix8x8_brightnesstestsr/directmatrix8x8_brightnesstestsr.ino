@@ -37,27 +37,27 @@ void setup() {
     // Turn on all the LEDs
     // I need to set the RED LEDs to output or they can prevent the
     // greens from displaying
-    for (uint8_t i = 0; i <= 8; i++)
+    for (uint8_t i = 0; i < 8; i++)
     {
 	pinMode(column_pins[i], OUTPUT);
 	digitalWrite(column_pins[i], LOW);
     }
-    for (uint8_t i = 0; i <= 8; i++)
+    for (uint8_t i = 0; i < 8; i++)
     {
 	pinMode(line_pins[i], OUTPUT);
 	digitalWrite(line_pins[i], LOW);
     }
-    pinMode(sr_pins[LATCH2_PIN], OUTPUT);
-    pinMode(sr_pins[DATA_PIN], OUTPUT);
-    pinMode(sr_pins[CLK_PIN], OUTPUT);
-    digitalWrite(sr_pins[LATCH2_PIN], LOW);
+    pinMode(LATCH2_PIN, OUTPUT);
+    pinMode(sr_pins[DATA], OUTPUT);
+    pinMode(sr_pins[CLK], OUTPUT);
+    digitalWrite(LATCH2_PIN, LOW);
     for (uint8_t i = 0; i <= 8; i++)
     {
-	digitalWrite(sr_pins[CLK_PIN], LOW);
-	digitalWrite(sr_pins[DATA_PIN], 1);
-	digitalWrite(sr_pins[CLK_PIN], HIGH);
+	digitalWrite(sr_pins[CLK], LOW);
+	digitalWrite(sr_pins[DATA], 1);
+	digitalWrite(sr_pins[CLK], HIGH);
     }
-    digitalWrite(sr_pins[LATCH2_PIN], HIGH);
+    digitalWrite(LATCH2_PIN, HIGH);
 
     delay(1000);
 
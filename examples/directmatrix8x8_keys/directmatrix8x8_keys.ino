@@ -0,0 +1,67 @@
+/*************************************************** 
+    Key matrix example: buttons wired between the row lines of the LED
+    matrix and 2 sense inputs (D2 and D3) are scanned by the refresh
+    interrupt, no separate scan loop needed.
+    Each button (with a diode, cathode on the row side) connects a row pin
+    to a sense pin, for 8 rows x 2 sense pins = 16 keys: key k is on row
+    k / 2 and sense pin k % 2. Holding a key lights the LED on its row, in
+    column 0 for D2 and column 1 for D3, and the last event is shown on
+    Serial when DEBUG is set.
+ ****************************************************/
+
+#include "LED_Matrix.h"
+
+// I shouldn't have to re-include these libs included in LED_Matrix.h
+#include <Wire.h>
+#include <Adafruit_GFX.h>
+#include <TimerOne.h>
+
+#define DEBUG 0
+
+// Integer pin numbers when built with -DNO_FASTIO (see LED_Matrix.h)
+#ifdef NO_FASTIO
+GPIO_pin_t line_pins[] = { 5, 6, 7, 8, 12, 11, 10, 9 };
+GPIO_pin_t column_pins[] = {  0,  4, A5, A4, A3, A2, A1, A0,
+                              DINV, DINV, DINV, DINV, DINV, DINV, DINV, DINV,
+                              DINV, DINV, DINV, DINV, DINV, DINV, DINV, DINV, };
+GPIO_pin_t sense_pins[] = { 2, 3 };
+#else
+GPIO_pin_t line_pins[] = { DP5, DP6, DP7, DP8, DP12, DP11, DP10, DP9 };
+GPIO_pin_t column_pins[] = {  DP0,  DP4, DP19, DP18, DP17, DP16, DP15, DP14,
+                              DINV, DINV, DINV, DINV, DINV, DINV, DINV, DINV,
+                              DINV, DINV, DINV, DINV, DINV, DINV, DINV, DINV, };
+GPIO_pin_t sense_pins[] = { DP2, DP3 };
+#endif
+
+// no shift register
+GPIO_pin_t sr_pins[] = { DINV, DINV, DINV, DINV, DINV };
+
+PWMDirectMatrix *matrix;
+
+void setup() {
+    if (DEBUG) Serial.begin(57600);
+
+    matrix = new PWMDirectMatrix(8, 8, 1);
+    matrix->begin(line_pins, column_pins, sr_pins, 200);
+    matrix->keys(sense_pins, 2);
+    matrix->clear();
+    matrix->writeDisplay();
+}
+
+void loop() {
+    int16_t event;
+
+    while ((event = matrix->readKey()) >= 0)
+    {
+	uint8_t key = event & ~DirectMatrix_KEY_PRESSED;
+
+	matrix->drawPixel(key % 2, key / 2, 
+	    (event & DirectMatrix_KEY_PRESSED) ? LED_RED_HIGH : 0);
+	matrix->writeDisplay();
+	if (DEBUG) Serial.print(F("key "));
+	if (DEBUG) Serial.print(key);
+	if (DEBUG) Serial.println((event & DirectMatrix_KEY_PRESSED) ? 
+				  F(" pressed") : F(" released"));
+    }
+    matrix->idle();
+}
@@ -42,18 +42,23 @@ VCC QA SER !OE RCLK SRCLCK !SRCLR !QH
 #define LATCH2_PIN DINV
 #define LATCH3_PIN DP0
 
+// The pin arrays are in flash and given to begin_P(), which only copies the
+// pins it needs (not the red and blue columns): 30 bytes of RAM less than
+// begin().
 // A0 -> DP14
-GPIO_pin_t line_pins[] = { DP17, DP16, DP15, DP14,  DP9, DP10, DP11, DP12 };
+const GPIO_pin_t line_pins[] PROGMEM = { DP17, DP16, DP15, DP14,  
+					 DP9, DP10, DP11, DP12 };
 
-GPIO_pin_t column_pins[] = {  DINV, DINV, DINV, DINV, DINV, DINV, DINV, DINV, 
+const GPIO_pin_t column_pins[] PROGMEM = {  DINV, DINV, DINV, DINV, DINV, DINV, DINV, DINV, 
                               DP8,  DP7,  DP6,  DP5,  DP4,  DP3,  DP2,  DP1,
                               DINV, DINV, DINV, DINV, DINV, DINV, DINV, DINV, };
 
 // LATCH1_PIN -> Latch pin for red, negative to invert the rows
 // DINV -> Green is directly connected
 // DINV -> no blue
-GPIO_pin_t sr_pins[] = { (GPIO_pin_t) -LATCH1_PIN, DINV, 
-			 (GPIO_pin_t) -LATCH3_PIN, DATA_PIN, CLK_PIN };
+const GPIO_pin_t sr_pins[] PROGMEM = { (GPIO_pin_t) -LATCH1_PIN, DINV, 
+				       (GPIO_pin_t) -LATCH3_PIN, DATA_PIN, 
+				       CLK_PIN };
 
 PWMDirectMatrix *matrix;
 
@@ -72,7 +77,7 @@ void setup() {
     // the flicker for my eyes.
     // For 3 colors, I need 180ns which leaves a spare 12ns for the main
     // loop for the fastest ISR interval.
-    matrix->begin(line_pins, column_pins, sr_pins, 180);
+    matrix->begin_P(line_pins, column_pins, sr_pins, 180);
 }
 
 static const uint8_t PROGMEM
@@ -0,0 +1,75 @@
+/*************************************************** 
+    HUB75 RGB panel example: a 32x16 1/8 scan panel, with the same 16
+    levels per color as the direct matrices, see DirectMatrix::beginHUB75().
+    The panel needs 1KB of frame buffer and 1KB of compiled planes, so
+    32x16 takes an ATmega2560. On an ATmega328 (Adafruit RGBmatrixPanel
+    wiring below), a 16x16 panel fits: set PANEL_COLS to 16.
+ ****************************************************/
+
+#include "LED_Matrix.h"
+
+// I shouldn't have to re-include these libs included in LED_Matrix.h
+#include <Wire.h>
+#include <Adafruit_GFX.h>
+#include <TimerOne.h>
+
+#ifndef FASTIO
+#error HUB75 needs FASTIO
+#endif
+
+#define PANEL_COLS 32
+#define PANEL_ROWS 16
+
+// R1 G1 B1 R2 G2 B2 must be on one port
+#if defined(__AVR_ATmega2560__)
+GPIO_pin_t rgb_pins[] = { DP24, DP25, DP26, DP27, DP28, DP29 };
+GPIO_pin_t addr_pins[] = { DP54, DP55, DP56 };		// A0 A1 A2
+GPIO_pin_t ctrl_pins[] = { DP11, DP57, DP9 };		// CLK LAT(A3) OE
+#else
+GPIO_pin_t rgb_pins[] = { DP2, DP3, DP4, DP5, DP6, DP7 };
+GPIO_pin_t addr_pins[] = { DP14, DP15, DP16 };		// A0 A1 A2
+GPIO_pin_t ctrl_pins[] = { DP8, DP17, DP9 };		// CLK LAT(A3) OE
+#endif
+
+PWMDirectMatrix *matrix;
+
+void setup() {
+    matrix = new PWMDirectMatrix(PANEL_ROWS, PANEL_COLS, 3);
+    matrix->beginHUB75(rgb_pins, addr_pins, ctrl_pins, 100);
+}
+
+void loop() {
+    // the 16 levels of each color, a band each
+    matrix->clear();
+    for (uint8_t x = 0; x < PANEL_COLS; x++)
+    {
+	uint8_t level = x * 16 / PANEL_COLS;
+	matrix->drawLine(x, 0, x, 4, level);
+	matrix->drawLine(x, 5, x, 9, level << 4);
+	matrix->drawLine(x, 10, x, 15, level << 8);
+    }
+    // nothing shows until writeDisplay() on HUB75 panels
+    matrix->writeDisplay();
+    matrix->idleDelay(3000);
+
+    // shapes across both halves of the panel
+    matrix->clear();
+    matrix->drawRect(0, 0, PANEL_COLS, PANEL_ROWS, LED_BLUE_MEDIUM);
+    matrix->drawCircle(PANEL_COLS / 4, 7, 5, LED_RED_HIGH);
+    matrix->drawLine(PANEL_COLS / 2, 2, PANEL_COLS - 3, 13, LED_GREEN_HIGH);
+    matrix->drawLine(PANEL_COLS / 2, 13, PANEL_COLS - 3, 2, LED_ORANGE_HIGH);
+    matrix->writeDisplay();
+    matrix->idleDelay(3000);
+
+    matrix->setTextWrap(false);
+    matrix->setTextSize(1);
+    for (int16_t x = PANEL_COLS; x >= -6 * 5; x--)
+    {
+	matrix->clear();
+	matrix->setCursor(x, 4);
+	matrix->setTextColor(LED_PURPLE_HIGH);
+	matrix->print("HUB75");
+	matrix->writeDisplay();
+	matrix->idleDelay(60);
+    }
+}
@@ -0,0 +1,63 @@
+/*************************************************** 
+    Multiplexed 4 digit 7 segment display (common cathode) on the
+    DirectMatrix scan: digits are rows, segments are columns, so each
+    digit gets the 16 levels of PWM.
+    To run digits next to an LED matrix from the same interrupt, wire the
+    digit commons as extra rows of the matrix sharing its column pins, and
+    give the first digit row to DirectSegments (e.g. 8 for an 8x8 matrix).
+ ****************************************************/
+
+#include "LED_Matrix.h"
+
+// I shouldn't have to re-include these libs included in LED_Matrix.h
+#include <Wire.h>
+#include <Adafruit_GFX.h>
+#include <TimerOne.h>
+
+#ifndef FASTIO
+// digit commons
+GPIO_pin_t digit_pins[] = { A0, A1, A2, A3 };
+// segments a b c d e f g dp
+GPIO_pin_t segment_pins[] = { 2, 3, 4, 5, 6, 7, 8, 9 };
+#else
+GPIO_pin_t digit_pins[] = { DP14, DP15, DP16, DP17 };
+GPIO_pin_t segment_pins[] = { DP2, DP3, DP4, DP5, DP6, DP7, DP8, DP9 };
+#endif
+GPIO_pin_t sr_pins[] = { DINV, DINV, DINV, DINV, DINV };
+
+DirectMatrix *matrix;
+DirectSegments *display;
+
+void setup() {
+    // 4 rows (digits) x 8 columns (segments), 1 color, common cathode
+    matrix = new DirectMatrix(4, 8, 1, 0);
+    matrix->begin(digit_pins, segment_pins, sr_pins, 200);
+    display = new DirectSegments(matrix, 0, 4);
+}
+
+void loop() {
+    display->clear();
+    display->print("HELO");
+    display->writeDisplay();
+    matrix->idleDelay(2000);
+
+    // fade in, using the PWM levels
+    for (uint8_t level = 1; level <= LED_RED_HIGH; level++)
+    {
+	display->setColor(level);
+	display->setCursor(0);
+	display->print("12.34");
+	display->writeDisplay();
+	matrix->idleDelay(150);
+    }
+
+    for (uint16_t i = 0; i <= 200; i++)
+    {
+	display->setCursor(0);
+	if (i < 100) display->print(' ');
+	if (i < 10) display->print(' ');
+	display->print(i / 10.0, 1);
+	display->writeDisplay();
+	matrix->idleDelay(20);
+    }
+}
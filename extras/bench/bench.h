@@ -0,0 +1,72 @@
+/*
+ * bench.h
+ *
+ * Timing shared by the benchmark sketches of extras/bench, included as
+ * "extras/bench/bench.h" (the library directory is on the include path,
+ * the sketch directory is copied elsewhere by the IDE).
+ *
+ * Times are in CPU cycles on a board or in simavr, and in nanoseconds in
+ * the host build (extras/host, make bench_<name>). A sketch may define
+ * BENCH_TARGET, the clock ticks each case runs for, before including it.
+ */
+
+#ifndef bench_h
+#define bench_h
+
+#include <string.h>
+
+#ifdef HOST_F_CPU
+#include <time.h>
+// Host build: the simulated clock does not count computation, use the wall
+// clock (ns) instead.
+#define BENCH_UNIT "ns"
+#define BENCH_PER_SECOND 1000000000.0
+#ifndef BENCH_TARGET
+#define BENCH_TARGET 20000000UL		// 20ms per case
+#endif
+static uint32_t bench_clock(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000UL + ts.tv_nsec;
+}
+#else
+#define BENCH_UNIT "cycles"
+#define BENCH_PER_SECOND ((double) F_CPU)
+#ifndef BENCH_TARGET
+#define BENCH_TARGET 100000UL		// 100ms per case
+#endif
+static uint32_t bench_clock(void) {
+    return micros();
+}
+#endif
+
+// Time per run(i) call in BENCH_UNIT, doubling the number of calls until
+// the run is long enough for the clock resolution and reading overhead not
+// to matter.
+template <class F> static double bench_per_call(F run) {
+    uint32_t calls = 1;
+    uint32_t elapsed;
+
+    for (;;)
+    {
+	uint32_t start = bench_clock();
+	for (uint32_t i = 0; i < calls; i++) run(i);
+	elapsed = bench_clock() - start;
+	if (elapsed >= BENCH_TARGET || calls >= 0x40000000UL) break;
+	calls <<= 1;
+    }
+#ifdef HOST_F_CPU
+    return (double) elapsed / calls;
+#else
+    return (double) elapsed * (F_CPU / 1000000UL) / calls;
+#endif
+}
+
+// Prints s left aligned in a column of width characters
+static void print_padded(const char *s, uint8_t width) {
+    Serial.print(s);
+    for (uint8_t i = strlen(s); i < width; i++) Serial.print(' ');
+}
+
+#endif
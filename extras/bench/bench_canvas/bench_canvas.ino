@@ -0,0 +1,158 @@
+/*
+ * bench_canvas.ino
+ *
+ * The same primitives as bench_draw, through PWMDirectMatrix (Adafruit_GFX,
+ * virtual drawPixel) and DirectCanvas (DirectGFX, static dispatch), for
+ * each rotation and a few panel sizes, printed to Serial as one line per
+ * case:
+ *   primitive panel rotation gfx/call canvas/call speedup same
+ * Times are in CPU cycles on a board or in simavr, and in nanoseconds in
+ * the host build (extras/host, make bench_canvas). same is 1 when both
+ * drew the same pixels.
+ *
+ * begin() is not called so the refresh ISR does not run.
+ * On an ATmega328 in simavr:
+ *   arduino-cli compile -b arduino:avr:nano --output-dir /tmp/bc bench_canvas
+ *   simavr -m atmega328p -f 16000000 /tmp/bc/bench_canvas.ino.hex
+ */
+
+#include "LED_Matrix.h"
+#include "DirectCanvas.h"
+#include <Wire.h>
+#include <Adafruit_GFX.h>
+#include <TimerOne.h>
+
+#include "extras/bench/bench.h"
+
+// Panel sizes (columns x rows), the matrices are allocated once and kept.
+static const uint8_t sizes[][2] = {
+    { 8, 8 }, { 16, 8 },
+#ifdef HOST_F_CPU
+    { 16, 16 }, { 32, 16 },
+#endif
+};
+#define NUM_SIZES (sizeof(sizes) / sizeof(sizes[0]))
+
+static const uint16_t PROGMEM bitmap[16] = {
+    LED_RED_HIGH, LED_GREEN_HIGH, LED_BLUE_HIGH, LED_WHITE_HIGH,
+    LED_RED_LOW, LED_GREEN_LOW, LED_BLUE_LOW, LED_WHITE_LOW,
+    LED_RED_HIGH, LED_GREEN_HIGH, LED_BLUE_HIGH, LED_WHITE_HIGH,
+    LED_RED_LOW, LED_GREEN_LOW, LED_BLUE_LOW, LED_WHITE_LOW,
+};
+
+// One call of each primitive, sized to the (rotated) panel. Templates so
+// that the same code is compiled for both classes.
+template <class M> static void bench_drawPixel(M &m, uint16_t i) {
+    m.drawPixel(i % m.width(), (i / m.width()) % m.height(), LED_RED_HIGH);
+}
+
+template <class M> static void bench_fillRect(M &m, uint16_t i) {
+    m.fillRect(0, 0, m.width(), m.height(), i);
+}
+
+template <class M> static void bench_drawLine(M &m, uint16_t i) {
+    m.drawLine(0, 0, m.width() - 1, m.height() - 1, i);
+}
+
+template <class M> static void bench_drawRect(M &m, uint16_t i) {
+    m.drawRect(1, 1, m.width() - 2, m.height() - 2, i);
+}
+
+template <class M> static void bench_drawCircle(M &m, uint16_t i) {
+    int16_t r = min(m.width(), m.height()) / 2 - 1;
+    m.drawCircle(m.width() / 2, m.height() / 2, r, i);
+}
+
+template <class M> static void bench_drawRGBBitmap(M &m, uint16_t i) {
+    m.drawRGBBitmap(0, 0, bitmap, 4, 4);
+}
+
+template <class M> static void bench_print(M &m, uint16_t i) {
+    m.setCursor(0, 0);
+    m.setTextColor(LED_GREEN_HIGH);
+    m.print("Hi");
+}
+
+struct bench_case {
+    const char *name;
+    void (*gfx)(PWMDirectMatrix &, uint16_t);
+    void (*canvas)(DirectCanvas &, uint16_t);
+};
+
+#define BENCH_CASE(f) { #f, bench_##f<PWMDirectMatrix>, bench_##f<DirectCanvas> }
+
+static const bench_case cases[] = {
+    BENCH_CASE(drawPixel),
+    BENCH_CASE(fillRect),
+    BENCH_CASE(drawLine),
+    BENCH_CASE(drawRect),
+    BENCH_CASE(drawCircle),
+    BENCH_CASE(drawRGBBitmap),
+    BENCH_CASE(print),
+};
+#define NUM_CASES (sizeof(cases) / sizeof(cases[0]))
+
+// Time per call of draw on m
+template <class M>
+static double time_case(M &m, void (*draw)(M &, uint16_t)) {
+    return bench_per_call([&](uint32_t i) { draw(m, i); });
+}
+
+// Both draw the case once on a clear panel, then the pixels are compared
+static uint8_t same_pixels(PWMDirectMatrix *gfx, DirectCanvas *canvas,
+	const bench_case *c) {
+    gfx->clear();
+    canvas->clear();
+    c->gfx(*gfx, 1);
+    c->canvas(*canvas, 1);
+    for (int16_t y = 0; y < gfx->height(); y++)
+	for (int16_t x = 0; x < gfx->width(); x++)
+	    if (gfx->getPixel(x, y) != canvas->getPixel(x, y)) return 0;
+    return 1;
+}
+
+static void run_case(PWMDirectMatrix *gfx, DirectCanvas *canvas,
+	uint8_t cols, uint8_t rows, uint8_t rotation, const bench_case *c) {
+    char panel[8];
+
+    gfx->setRotation(rotation);
+    canvas->setRotation(rotation);
+    uint8_t same = same_pixels(gfx, canvas, c);
+    double t_gfx = time_case(*gfx, c->gfx);
+    double t_canvas = time_case(*canvas, c->canvas);
+
+    snprintf(panel, sizeof(panel), "%dx%d", cols, rows);
+    print_padded(c->name, 15);
+    print_padded(panel, 7);
+    Serial.print(rotation);
+    Serial.print(F("  "));
+    Serial.print(t_gfx, 1);
+    Serial.print(F("  "));
+    Serial.print(t_canvas, 1);
+    Serial.print(F("  "));
+    Serial.print(t_gfx / t_canvas, 2);
+    Serial.print(F("  "));
+    Serial.println(same);
+}
+
+void setup() {
+    Serial.begin(115200);
+    Serial.print(F("# primitive panel rotation gfx " BENCH_UNIT "/call canvas "
+	BENCH_UNIT "/call speedup same\n"));
+
+    for (uint8_t s = 0; s < NUM_SIZES; s++)
+    {
+	uint8_t cols = sizes[s][0];
+	uint8_t rows = sizes[s][1];
+	PWMDirectMatrix *gfx = new PWMDirectMatrix(rows, cols, 3);
+	DirectCanvas *canvas = new DirectCanvas(rows, cols, 3);
+
+	for (uint8_t c = 0; c < NUM_CASES; c++)
+	    for (uint8_t rotation = 0; rotation < 4; rotation++)
+		run_case(gfx, canvas, cols, rows, rotation, &cases[c]);
+    }
+    Serial.println(F("# done"));
+}
+
+void loop() {
+}
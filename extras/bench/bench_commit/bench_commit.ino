@@ -0,0 +1,125 @@
+/*
+ * bench_commit.ino
+ *
+ * Cost of committing a frame with writeDisplay() on a HUB75 panel, where
+ * the frame is compiled into port bytes: in one go (backgroundCompile(0))
+ * and spread over the refresh interrupts with 1, 2 and 4 steps per
+ * interrupt. Printed to Serial as one line per case:
+ *   panel steps commit/call shown_after_us max_isr_us
+ * commit is the time writeDisplay() blocks the caller, in CPU cycles on a
+ * board or in simavr and in nanoseconds in the host build (extras/host,
+ * make bench_commit). shown_after is how long the new frame takes to be
+ * shown, max_isr the longest refresh interrupt meanwhile (on the host,
+ * both are simulated time, which does not count the compilation).
+ *
+ * On an ATmega2560 in simavr:
+ *   arduino-cli compile -b arduino:avr:mega --output-dir /tmp/bm bench_commit
+ *   simavr -m atmega2560 -f 16000000 /tmp/bm/bench_commit.ino.hex
+ */
+
+#include "LED_Matrix.h"
+#include <Wire.h>
+#include <Adafruit_GFX.h>
+#include <TimerOne.h>
+
+#ifndef FASTIO
+#error HUB75 needs FASTIO
+#endif
+
+#ifndef HOST_F_CPU
+#define BENCH_TARGET 200000UL		// 200ms per case
+#endif
+#include "extras/bench/bench.h"
+
+// Same wiring as examples/hub75_32x16
+#if defined(__AVR_ATmega2560__)
+GPIO_pin_t rgb_pins[] = { DP24, DP25, DP26, DP27, DP28, DP29 };
+GPIO_pin_t addr_pins[] = { DP54, DP55, DP56, DP57 };
+GPIO_pin_t ctrl_pins[] = { DP11, DP58, DP9 };
+#else
+GPIO_pin_t rgb_pins[] = { DP2, DP3, DP4, DP5, DP6, DP7 };
+GPIO_pin_t addr_pins[] = { DP14, DP15, DP16, DP18 };
+GPIO_pin_t ctrl_pins[] = { DP8, DP17, DP9 };
+#endif
+
+// Panel sizes (columns x rows). A matrix takes 6 * rows * cols bytes with
+// the compiled planes and the second buffer of backgroundCompile(), and is
+// deleted before the next size.
+static const uint8_t sizes[][2] = {
+    { 16, 16 },
+#if defined(HOST_F_CPU) || defined(__AVR_ATmega2560__)
+    { 32, 16 },
+#endif
+#ifdef HOST_F_CPU
+    { 32, 32 },
+#endif
+};
+#define NUM_SIZES (sizeof(sizes) / sizeof(sizes[0]))
+
+static const uint8_t steps[] = { 0, 1, 2, 4 };
+#define NUM_STEPS (sizeof(steps) / sizeof(steps[0]))
+
+// A frame with all the levels so that every plane has lit bits
+static void draw_frame(PWMDirectMatrix *matrix, uint8_t frame) {
+    for (uint8_t y = 0; y < matrix->rows(); y++)
+	for (uint8_t x = 0; x < matrix->cols(); x++)
+	{
+	    uint8_t level = (x + y + frame) & 15;
+	    matrix->drawPixel(x, y, level | (15 - level) << 4 | level << 8);
+	}
+}
+
+static void run_case(PWMDirectMatrix *matrix, const char *panel,
+	uint8_t step) {
+    uint32_t max_isr = 0;
+
+    matrix->backgroundCompile(step);
+    double t = bench_per_call([&](uint32_t) { matrix->writeDisplay(); });
+
+    // a new frame, and how long until it shows
+    matrix->idleDelay(50);
+    draw_frame(matrix, 1);
+    uint32_t start = micros();
+    matrix->writeDisplay();
+    while (matrix->compiling())
+    {
+	// not idle(): on the host, it does not move the simulated time
+	delayMicroseconds(10);
+	if (matrix->ISR_runtime() > max_isr) max_isr = matrix->ISR_runtime();
+    }
+    uint32_t shown = micros() - start;
+
+    print_padded(panel, 7);
+    Serial.print(step);
+    Serial.print(F("  "));
+    Serial.print(t, 0);
+    Serial.print(F("  "));
+    Serial.print(shown);
+    Serial.print(F("  "));
+    Serial.println(max_isr);
+}
+
+void setup() {
+    Serial.begin(115200);
+    Serial.print(F("# panel steps commit " BENCH_UNIT
+	"/call shown_after_us max_isr_us\n"));
+
+    for (uint8_t s = 0; s < NUM_SIZES; s++)
+    {
+	char panel[8];
+	uint8_t cols = sizes[s][0];
+	uint8_t rows = sizes[s][1];
+	PWMDirectMatrix *matrix = new PWMDirectMatrix(rows, cols, 3);
+
+	matrix->beginHUB75(rgb_pins, addr_pins, ctrl_pins, 100);
+	draw_frame(matrix, 0);
+	snprintf(panel, sizeof(panel), "%dx%d", cols, rows);
+	for (uint8_t i = 0; i < NUM_STEPS; i++)
+	    run_case(matrix, panel, steps[i]);
+	delete matrix;
+    }
+    Serial.println(F("# done"));
+}
+
+void loop() {
+}
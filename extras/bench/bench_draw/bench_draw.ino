@@ -0,0 +1,154 @@
+/*
+ * bench_draw.ino
+ *
+ * Drawing throughput of PWMDirectMatrix: time spent in drawPixel, fillRect,
+ * drawLine, drawCircle, drawRGBBitmap and print for each rotation and a few
+ * panel sizes, printed to Serial as one line per case:
+ *   primitive panel rotation pixels/call time/call pixels/s
+ * time/call is in CPU cycles on a board or in simavr, and in nanoseconds in
+ * the host build (extras/host, make bench_draw).
+ *
+ * Only the drawing path is measured: begin() is not called so the refresh
+ * ISR does not run, but the millis() interrupt does (about 1% on AVR).
+ * On an ATmega328 in simavr:
+ *   arduino-cli compile -b arduino:avr:nano --output-dir /tmp/db bench_draw
+ *   simavr -m atmega328p -f 16000000 /tmp/db/bench_draw.ino.hex
+ */
+
+#include "LED_Matrix.h"
+#include <Wire.h>
+#include <Adafruit_GFX.h>
+#include <TimerOne.h>
+
+#include "extras/bench/bench.h"
+
+// Panel sizes (columns x rows), the matrices are allocated once and kept.
+static const uint8_t sizes[][2] = {
+    { 8, 8 }, { 16, 8 }, { 24, 8 },
+#ifdef HOST_F_CPU
+    { 16, 16 }, { 32, 16 },
+#endif
+};
+#define NUM_SIZES (sizeof(sizes) / sizeof(sizes[0]))
+
+static const uint16_t PROGMEM bitmap[64] = {
+    LED_RED_HIGH, LED_GREEN_HIGH, LED_BLUE_HIGH, LED_WHITE_HIGH,
+    LED_RED_LOW, LED_GREEN_LOW, LED_BLUE_LOW, LED_WHITE_LOW,
+    LED_RED_HIGH, LED_GREEN_HIGH, LED_BLUE_HIGH, LED_WHITE_HIGH,
+    LED_RED_LOW, LED_GREEN_LOW, LED_BLUE_LOW, LED_WHITE_LOW,
+    LED_RED_HIGH, LED_GREEN_HIGH, LED_BLUE_HIGH, LED_WHITE_HIGH,
+    LED_RED_LOW, LED_GREEN_LOW, LED_BLUE_LOW, LED_WHITE_LOW,
+    LED_RED_HIGH, LED_GREEN_HIGH, LED_BLUE_HIGH, LED_WHITE_HIGH,
+    LED_RED_LOW, LED_GREEN_LOW, LED_BLUE_LOW, LED_WHITE_LOW,
+    LED_RED_HIGH, LED_GREEN_HIGH, LED_BLUE_HIGH, LED_WHITE_HIGH,
+    LED_RED_LOW, LED_GREEN_LOW, LED_BLUE_LOW, LED_WHITE_LOW,
+    LED_RED_HIGH, LED_GREEN_HIGH, LED_BLUE_HIGH, LED_WHITE_HIGH,
+    LED_RED_LOW, LED_GREEN_LOW, LED_BLUE_LOW, LED_WHITE_LOW,
+    LED_RED_HIGH, LED_GREEN_HIGH, LED_BLUE_HIGH, LED_WHITE_HIGH,
+    LED_RED_LOW, LED_GREEN_LOW, LED_BLUE_LOW, LED_WHITE_LOW,
+    LED_RED_HIGH, LED_GREEN_HIGH, LED_BLUE_HIGH, LED_WHITE_HIGH,
+    LED_RED_LOW, LED_GREEN_LOW, LED_BLUE_LOW, LED_WHITE_LOW,
+};
+
+// One call of each primitive, sized to the (rotated) panel.
+// drawPixel is timed one pixel per call.
+static void bench_drawPixel(Adafruit_GFX &gfx, uint16_t i) {
+    gfx.drawPixel(i % gfx.width(), (i / gfx.width()) % gfx.height(),
+	LED_RED_HIGH);
+}
+
+static void bench_fillRect(Adafruit_GFX &gfx, uint16_t i) {
+    gfx.fillRect(0, 0, gfx.width(), gfx.height(), i);
+}
+
+static void bench_drawLine(Adafruit_GFX &gfx, uint16_t i) {
+    gfx.drawLine(0, 0, gfx.width() - 1, gfx.height() - 1, i);
+}
+
+static void bench_drawCircle(Adafruit_GFX &gfx, uint16_t i) {
+    int16_t r = min(gfx.width(), gfx.height()) / 2 - 1;
+    gfx.drawCircle(gfx.width() / 2, gfx.height() / 2, r, i);
+}
+
+static void bench_drawRGBBitmap(Adafruit_GFX &gfx, uint16_t i) {
+    gfx.drawRGBBitmap(0, 0, bitmap, 8, 8);
+}
+
+static void bench_print(Adafruit_GFX &gfx, uint16_t i) {
+    gfx.setCursor(0, 0);
+    gfx.setTextColor(LED_GREEN_HIGH);
+    gfx.print("Hi");
+}
+
+struct bench_case {
+    const char *name;
+    void (*draw)(Adafruit_GFX &, uint16_t);
+};
+
+static const bench_case cases[] = {
+    { "drawPixel", bench_drawPixel },
+    { "fillRect", bench_fillRect },
+    { "drawLine", bench_drawLine },
+    { "drawCircle", bench_drawCircle },
+    { "drawRGBBitmap", bench_drawRGBBitmap },
+    { "print", bench_print },
+};
+#define NUM_CASES (sizeof(cases) / sizeof(cases[0]))
+
+// Counts the pixels a primitive writes inside the panel, so that the timed
+// run goes through PWMDirectMatrix untouched.
+class PixelCounter : public Adafruit_GFX {
+ public:
+  PixelCounter(int16_t w, int16_t h) : Adafruit_GFX(w, h), pixels(0) { }
+  void drawPixel(int16_t x, int16_t y, uint16_t color) {
+    if (x >= 0 && y >= 0 && x < _width && y < _height) pixels++;
+  }
+  uint32_t pixels;
+};
+
+static void run_case(PWMDirectMatrix *matrix, uint8_t cols, uint8_t rows,
+	uint8_t rotation, const bench_case *c) {
+    PixelCounter counter(cols, rows);
+    char panel[8];
+
+    counter.setRotation(rotation);
+    c->draw(counter, 0);
+    matrix->setRotation(rotation);
+    double t = bench_per_call([&](uint32_t i) { c->draw(*matrix, i); });
+
+    snprintf(panel, sizeof(panel), "%dx%d", cols, rows);
+    print_padded(c->name, 15);
+    print_padded(panel, 7);
+    Serial.print(rotation);
+    Serial.print(F("  "));
+    Serial.print(counter.pixels);
+    Serial.print(F("  "));
+#ifdef HOST_F_CPU
+    Serial.print(t, 1);
+#else
+    Serial.print(t, 0);
+#endif
+    Serial.print(F("  "));
+    Serial.println(counter.pixels * BENCH_PER_SECOND / t, 0);
+}
+
+void setup() {
+    Serial.begin(115200);
+    Serial.print(F("# primitive panel rotation pixels/call " BENCH_UNIT
+	"/call pixels/s\n"));
+
+    for (uint8_t s = 0; s < NUM_SIZES; s++)
+    {
+	uint8_t cols = sizes[s][0];
+	uint8_t rows = sizes[s][1];
+	PWMDirectMatrix *matrix = new PWMDirectMatrix(rows, cols, 3);
+
+	for (uint8_t c = 0; c < NUM_CASES; c++)
+	    for (uint8_t rotation = 0; rotation < 4; rotation++)
+		run_case(matrix, cols, rows, rotation, &cases[c]);
+    }
+    Serial.println(F("# done"));
+}
+
+void loop() {
+}
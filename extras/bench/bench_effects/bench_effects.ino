@@ -0,0 +1,113 @@
+/*
+ * bench_effects.ino
+ *
+ * Time per frame of the DirectEffects kernels (plasma, fire, noise), and
+ * of the same plasma written with sin() and floats for comparison, for a
+ * few panel sizes, printed to Serial as one line per case:
+ *   effect panel time/frame frames/s
+ * Times are in CPU cycles on a board or in simavr, and in nanoseconds in
+ * the host build (extras/host, make bench_effects), frames/s is for the
+ * CPU the bench runs on, with no refresh ISR.
+ *
+ * begin() is not called so the refresh ISR does not run.
+ * On an ATmega328 in simavr:
+ *   arduino-cli compile -b arduino:avr:nano --output-dir /tmp/be bench_effects
+ *   simavr -m atmega328p -f 16000000 /tmp/be/bench_effects.ino.hex
+ */
+
+#include "LED_Matrix.h"
+#include "LED_Effects.h"
+#include <Wire.h>
+#include <Adafruit_GFX.h>
+#include <TimerOne.h>
+
+#ifndef HOST_F_CPU
+#define BENCH_TARGET 200000UL		// 200ms per case
+#endif
+#include "extras/bench/bench.h"
+
+// Panel sizes (columns x rows), the matrices are allocated once and kept.
+static const uint8_t sizes[][2] = {
+    { 8, 8 }, { 16, 8 }, { 16, 16 },
+#ifdef HOST_F_CPU
+    { 32, 16 }, { 32, 32 },
+#endif
+};
+#define NUM_SIZES (sizeof(sizes) / sizeof(sizes[0]))
+
+static DirectMatrix *matrix;
+static DirectEffects *fx;
+
+// One frame of each effect, frame is the frame number.
+static void bench_plasma(uint16_t frame) {
+    fx->plasma(frame * 2);
+}
+
+static void bench_fire(uint16_t frame) {
+    fx->fire();
+}
+
+static void bench_noise(uint16_t frame) {
+    fx->noise(frame * 8, frame * 4, frame * 16, 64);
+}
+
+// The plasma the usual way, the same four waves in floats with sin()
+static void bench_plasma_float(uint16_t frame) {
+    float t = frame * 2 * (2 * PI / 256);
+
+    for (uint8_t y = 0; y < matrix->rows(); y++)
+    {
+	uint16_t *pixels = matrix->row(y);
+	for (uint8_t x = 0; x < matrix->cols(); x++)
+	{
+	    float v = sin(y * (2 * PI / 16) + t / 2) + sin(x * (2 * PI / 16) + t)
+		+ sin((x + y) * (2 * PI / 32) - t)
+		+ sin((x - y) * (10 * PI / 128) + 3 * t);
+	    uint8_t hue = (uint8_t) ((v + 4) * 32 + frame * 2) >> 4;
+	    pixels[x] = pgm_read_word(&DirectEffects_RainbowPalette[hue]);
+	}
+    }
+}
+
+struct bench_case {
+    const char *name;
+    void (*frame)(uint16_t);
+};
+
+static const bench_case cases[] = {
+    { "plasma", bench_plasma },
+    { "fire", bench_fire },
+    { "noise", bench_noise },
+    { "plasma_float", bench_plasma_float },
+};
+#define NUM_CASES (sizeof(cases) / sizeof(cases[0]))
+
+void setup() {
+    Serial.begin(115200);
+    Serial.print(F("# effect panel " BENCH_UNIT "/frame frames/s\n"));
+
+    for (uint8_t s = 0; s < NUM_SIZES; s++)
+    {
+	char panel[8];
+	uint8_t cols = sizes[s][0];
+	uint8_t rows = sizes[s][1];
+
+	matrix = new DirectMatrix(rows, cols, 3, 0);
+	fx = new DirectEffects(matrix);
+	snprintf(panel, sizeof(panel), "%dx%d", cols, rows);
+	for (uint8_t c = 0; c < NUM_CASES; c++)
+	{
+	    double t = bench_per_call(cases[c].frame);
+
+	    print_padded(cases[c].name, 14);
+	    print_padded(panel, 7);
+	    Serial.print(t, 0);
+	    Serial.print(F("  "));
+	    Serial.println(BENCH_PER_SECOND / t, 1);
+	}
+    }
+    Serial.println(F("# done"));
+}
+
+void loop() {
+}
@@ -0,0 +1,61 @@
+/*
+ * footprint.cpp
+ *
+ * Minimal sketch used by footprint.py to measure what the library costs
+ * in flash and RAM for a given configuration:
+ * - FP_COLORS: 1 to 3 colors
+ * - FP_SR: 0 for direct columns, 1 for colors after the first one on
+ *   shift registers (all colors on SR for 1 color)
+ * - FP_BASELINE: same sketch without the library, subtracted from the
+ *   other builds so that the Arduino core does not count.
+ */
+
+#include <Arduino.h>
+
+#ifndef FP_BASELINE
+#include "LED_Matrix.h"
+
+#ifdef FASTIO
+#define P(fast, slow) fast
+#else
+#define P(fast, slow) slow
+#endif
+
+#if FP_SR
+#define SR_COLOR(n) ((n) > 0 || FP_COLORS == 1)
+#else
+#define SR_COLOR(n) 0
+#endif
+
+GPIO_pin_t line_pins[] = { P(DP5, 5), P(DP6, 6), P(DP7, 7), P(DP8, 8),
+			   P(DP12, 12), P(DP11, 11), P(DP10, 10), P(DP9, 9) };
+GPIO_pin_t column_pins[] = {
+    P(DP0, 0), P(DP4, 4), P(DP19, A5), P(DP18, A4),
+    P(DP17, A3), P(DP16, A2), P(DP15, A1), P(DP14, A0),
+    DINV, DINV, DINV, DINV, DINV, DINV, DINV, DINV,
+    DINV, DINV, DINV, DINV, DINV, DINV, DINV, DINV, };
+GPIO_pin_t sr_pins[] = { SR_COLOR(0) ? P(DP1, 1) : DINV,
+			 SR_COLOR(1) ? P(DP13, 13) : DINV,
+			 SR_COLOR(2) ? P(DP1, 1) : DINV,
+			 P(DP3, 3), P(DP2, 2) };
+
+PWMDirectMatrix *matrix;
+#endif
+
+void setup() {
+#ifndef FP_BASELINE
+    matrix = new PWMDirectMatrix(8, 8, FP_COLORS);
+    matrix->begin(line_pins, column_pins, sr_pins, 200);
+    matrix->clear();
+    matrix->fillRect(0, 0, 8, 8, LED_WHITE_HIGH);
+    matrix->writeDisplay();
+#endif
+}
+
+void loop() {
+#ifndef FP_BASELINE
+    matrix->drawPixel(random(8), random(8), random(4096));
+    matrix->writeDisplay();
+#endif
+    delay(10);
+}
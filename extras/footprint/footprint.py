@@ -0,0 +1,233 @@
+#!/usr/bin/env python3
+"""Flash/RAM footprint of the LED-Matrix library across configurations.
+
+Builds footprint.cpp with avr-gcc for an ATmega328P for each combination
+of colors (1-3), direct vs shift register columns, FASTIO on/off and
+GPIO2_PREFER_SPEED 1/0, and reports what the library adds to .text, .data
+and .bss compared to the same sketch without it, plus the stack used by
+the refresh interrupt (from -fstack-usage).
+
+The report is plain text with one line per configuration, so it can be
+saved and diffed between revisions:
+    footprint.py > footprint.txt
+    footprint.py --compare footprint.txt   # exits 1 if anything grew
+
+It needs an Arduino AVR core and the TimerOne and Adafruit-GFX libraries,
+found in the usual places or given with --core/--libraries.
+"""
+
+import argparse
+import glob
+import itertools
+import os
+import re
+import shutil
+import subprocess
+import sys
+import tempfile
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+LIB = os.path.normpath(os.path.join(HERE, "..", ".."))
+
+MCU = "atmega328p"
+CFLAGS = ["-mmcu=" + MCU, "-DF_CPU=16000000L", "-DARDUINO=10600",
+          "-DARDUINO_AVR_NANO", "-DARDUINO_ARCH_AVR", "-Os", "-g",
+          "-ffunction-sections", "-fdata-sections", "-fstack-usage", "-w"]
+CXXFLAGS = ["-std=gnu++11", "-fno-exceptions", "-fno-threadsafe-statics"]
+LDFLAGS = ["-mmcu=" + MCU, "-Os", "-Wl,--gc-sections"]
+
+# The refresh ISR call chain: Timer1 vector -> TimerOne callback -> our ISR
+ISR_CHAIN = ["__vector_13", "DirectMatrix_RefreshPWMLine"]
+# What the ISR calls, the deepest of these counts on top of the chain
+ISR_CALLEES = ["micros", "setPeriod", "internal_digitalWrite2",
+               "digitalWrite", "DirectMatrix_Degrade"]
+
+
+def find_core(path):
+    candidates = [path] if path else (
+        glob.glob(os.path.expanduser(
+            "~/.arduino15/packages/arduino/hardware/avr/*")) +
+        ["/usr/share/arduino/hardware/arduino/avr",
+         "/usr/share/arduino/hardware/arduino"])
+    for c in candidates:
+        if c and os.path.isdir(os.path.join(c, "cores", "arduino")):
+            return c
+    sys.exit("Arduino AVR core not found, use --core")
+
+
+def find_library(libraries, header):
+    for d in libraries:
+        for h in glob.glob(os.path.join(d, "*", header)) + \
+                 glob.glob(os.path.join(d, "*", "src", header)):
+            return os.path.dirname(h)
+    sys.exit("%s not found, use --libraries" % header)
+
+
+class Builder:
+    def __init__(self, args, tmp):
+        self.args = args
+        self.tmp = tmp
+        core = find_core(args.core)
+        self.core_dir = os.path.join(core, "cores", "arduino")
+        self.variant_dir = os.path.join(core, "variants", "standard")
+        libs = args.libraries or [os.path.expanduser("~/Arduino/libraries"),
+                                  os.path.join(core, "libraries")]
+        self.timerone = find_library(libs, "TimerOne.h")
+        self.gfx = find_library(libs, "Adafruit_GFX.h")
+        self.includes = ["-I" + d for d in (
+            self.core_dir, self.variant_dir, LIB, self.timerone, self.gfx)]
+
+    def run(self, cmd, cwd=None):
+        if self.args.dry_run:
+            print(" ".join(cmd), file=sys.stderr)
+            return ""
+        r = subprocess.run(cmd, cwd=cwd, stdout=subprocess.PIPE,
+                           stderr=subprocess.STDOUT, universal_newlines=True)
+        if r.returncode:
+            sys.exit("failed: %s\n%s" % (" ".join(cmd), r.stdout))
+        return r.stdout
+
+    def compile(self, src, out_dir, defines):
+        obj = os.path.join(out_dir, os.path.basename(src) + ".o")
+        cpp = src.endswith(".cpp")
+        cmd = [self.args.cxx if cpp else self.args.cc] + CFLAGS + \
+            (CXXFLAGS if cpp else []) + defines + self.includes + \
+            ["-c", src, "-o", obj]
+        self.run(cmd, cwd=out_dir)
+        return obj
+
+    def build(self, name, defines, with_lib=True):
+        out_dir = os.path.join(self.tmp, name)
+        os.makedirs(out_dir, exist_ok=True)
+        srcs = sorted(glob.glob(os.path.join(self.core_dir, "*.c")) +
+                      glob.glob(os.path.join(self.core_dir, "*.cpp")))
+        srcs.append(os.path.join(HERE, "footprint.cpp"))
+        if with_lib:
+            srcs += [os.path.join(LIB, "LED_Matrix.cpp"),
+                     os.path.join(self.timerone, "TimerOne.cpp"),
+                     os.path.join(self.gfx, "Adafruit_GFX.cpp")]
+            if "-DGPIO2_PREFER_SPEED=0" in defines:
+                # non inline fast I/O workers
+                srcs.append(os.path.join(LIB, "dio2", "digital2.c"))
+        objs = [self.compile(s, out_dir, defines) for s in srcs]
+        elf = os.path.join(out_dir, name + ".elf")
+        self.run([self.args.cxx] + LDFLAGS + objs + ["-o", elf])
+        return elf, out_dir
+
+    def sizes(self, elf):
+        out = self.run([self.args.size, "-A", elf])
+        sizes = {}
+        for line in out.splitlines():
+            m = re.match(r"^\.(text|data|bss)\s+(\d+)", line)
+            if m:
+                sizes[m.group(1)] = int(m.group(2))
+        return sizes
+
+
+def stack_usage(out_dir):
+    """Worst case stack of the refresh ISR from the -fstack-usage files."""
+    frames = {}
+    for su in glob.glob(os.path.join(out_dir, "*.su")):
+        for line in open(su):
+            fields = line.rstrip("\n").split("\t")
+            if len(fields) < 2:
+                continue
+            func = fields[0].rsplit(":", 1)[-1]
+            func = re.sub(r"\(.*", "", func).split("::")[-1]
+            frames[func] = max(frames.get(func, 0), int(fields[1]))
+    # 2 bytes of return address per call level, the vector also pushes
+    # SREG and the call clobbered registers which is in its frame size.
+    total = sum(frames.get(f, 0) + 2 for f in ISR_CHAIN)
+    total += max([frames[f] + 2 for f in ISR_CALLEES if f in frames] or [0])
+    return total
+
+
+def configurations():
+    for colors, sr, fastio, speed in itertools.product(
+            (1, 2, 3), (0, 1), (1, 0), (1, 0)):
+        if not fastio and not speed:
+            continue  # GPIO2_PREFER_SPEED only matters with FASTIO
+        name = "%dcolor-%s-%s%s" % (colors, "sr" if sr else "direct",
+                                    "fastio" if fastio else "arduinoio",
+                                    "" if not fastio else
+                                    ("-speed" if speed else "-size"))
+        defines = ["-DFP_COLORS=%d" % colors, "-DFP_SR=%d" % sr,
+                   "-DGPIO2_PREFER_SPEED=%d" % speed]
+        if not fastio:
+            defines.append("-DNO_FASTIO")
+        yield name, defines
+
+
+def report(builder, out):
+    base_elf, _ = builder.build("baseline", ["-DFP_BASELINE"], False)
+    base = builder.sizes(base_elf)
+    out.write("# LED-Matrix footprint on %s, bytes added to an empty sketch\n"
+              % MCU)
+    out.write("# %-32s %6s %6s %6s %9s\n" % ("config", "text", "data", "bss",
+                                              "isr_stack"))
+    results = {}
+    for name, defines in configurations():
+        elf, out_dir = builder.build(name, defines)
+        s = builder.sizes(elf)
+        row = [s.get(k, 0) - base.get(k, 0) for k in ("text", "data", "bss")]
+        row.append(stack_usage(out_dir))
+        results[name] = row
+        out.write("%-34s %6d %6d %6d %9d\n" % tuple([name] + row))
+        out.flush()
+    return results
+
+
+def load(path):
+    results = {}
+    for line in open(path):
+        if line.startswith("#") or not line.strip():
+            continue
+        f = line.split()
+        results[f[0]] = [int(v) for v in f[1:]]
+    return results
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--core", help="Arduino AVR core directory")
+    parser.add_argument("--libraries", action="append",
+                        help="Arduino libraries directory (repeatable)")
+    parser.add_argument("--compare", metavar="REPORT",
+                        help="compare against a saved report")
+    parser.add_argument("--cc", default="avr-gcc")
+    parser.add_argument("--cxx", default="avr-g++")
+    parser.add_argument("--size", default="avr-size")
+    parser.add_argument("--keep", action="store_true",
+                        help="keep the build directory")
+    parser.add_argument("--dry-run", action="store_true",
+                        help="print the commands instead of running them")
+    args = parser.parse_args()
+
+    if not args.dry_run and not shutil.which(args.cxx):
+        sys.exit("%s not found" % args.cxx)
+    tmp = tempfile.mkdtemp(prefix="footprint-")
+    try:
+        results = report(Builder(args, tmp), sys.stdout)
+    finally:
+        if args.keep:
+            print("build directory: " + tmp, file=sys.stderr)
+        else:
+            shutil.rmtree(tmp)
+
+    if args.compare and not args.dry_run:
+        old = load(args.compare)
+        grew = False
+        for name, row in results.items():
+            if name not in old:
+                continue
+            for col, new, was in zip(("text", "data", "bss", "isr_stack"),
+                                     row, old[name]):
+                if new > was:
+                    grew = True
+                    print("%s: %s grew from %d to %d (+%d)"
+                          % (name, col, was, new, new - was), file=sys.stderr)
+        sys.exit(1 if grew else 0)
+
+
+if __name__ == "__main__":
+    main()
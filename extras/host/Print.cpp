@@ -0,0 +1,82 @@
+/*
+ * Print.cpp
+ *
+ * Host stand-in for the Arduino Print class.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "Arduino.h"
+
+size_t Print::write(const uint8_t *buffer, size_t size) {
+    size_t n = 0;
+
+    while (size--) n += write(*buffer++);
+    return n;
+}
+
+size_t Print::write(const char *str) {
+    if (! str) return 0;
+    return write((const uint8_t *) str, strlen(str));
+}
+
+size_t Print::print(const __FlashStringHelper *str) {
+    return write(reinterpret_cast<const char *>(str));
+}
+
+size_t Print::print(const char str[]) {
+    return write(str);
+}
+
+size_t Print::print(char c) {
+    return write((uint8_t) c);
+}
+
+size_t Print::print(unsigned char b, int base) {
+    return print((unsigned long) b, base);
+}
+
+size_t Print::print(int n, int base) {
+    return print((long) n, base);
+}
+
+size_t Print::print(unsigned int n, int base) {
+    return print((unsigned long) n, base);
+}
+
+size_t Print::print(long n, int base) {
+    if (base == 10 && n < 0)
+    {
+	return print('-') + printNumber(-n, 10);
+    }
+    return printNumber(n, base);
+}
+
+size_t Print::print(unsigned long n, int base) {
+    return printNumber(n, base);
+}
+
+size_t Print::print(double number, int digits) {
+    char buf[64];
+
+    snprintf(buf, sizeof(buf), "%.*f", digits, number);
+    return write(buf);
+}
+
+size_t Print::println(void) {
+    return write("\r\n");
+}
+
+size_t Print::printNumber(unsigned long n, uint8_t base) {
+    char buf[8 * sizeof(long) + 1];
+    char *str = &buf[sizeof(buf) - 1];
+
+    if (base < 2) base = 10;
+    *str = '\0';
+    do {
+	char c = n % base;
+	n /= base;
+	*--str = c < 10 ? c + '0' : c + 'A' - 10;
+    } while (n);
+    return write(str);
+}
@@ -0,0 +1,52 @@
+/*
+ * Print.h
+ *
+ * Host stand-in for the Arduino Print class (Serial, Adafruit_GFX text).
+ */
+
+#ifndef Print_h
+#define Print_h
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>	// the AVR Print.h has it too
+
+class __FlashStringHelper;
+#define F(string_literal) (reinterpret_cast<const __FlashStringHelper *>(string_literal))
+
+class Print {
+ public:
+  virtual ~Print() { }
+  virtual size_t write(uint8_t) = 0;
+  virtual size_t write(const uint8_t *buffer, size_t size);
+  size_t write(const char *str);
+  size_t write(const char *buffer, size_t size) {
+    return write((const uint8_t *) buffer, size);
+  }
+
+  size_t print(const __FlashStringHelper *);
+  size_t print(const char[]);
+  size_t print(char);
+  size_t print(unsigned char, int = DEC_BASE);
+  size_t print(int, int = DEC_BASE);
+  size_t print(unsigned int, int = DEC_BASE);
+  size_t print(long, int = DEC_BASE);
+  size_t print(unsigned long, int = DEC_BASE);
+  size_t print(double, int = 2);
+
+  size_t println(void);
+  template <typename T> size_t println(T value) {
+    size_t n = print(value);
+    return n + println();
+  }
+  template <typename T> size_t println(T value, int format) {
+    size_t n = print(value, format);
+    return n + println();
+  }
+
+ private:
+  enum { DEC_BASE = 10 };
+  size_t printNumber(unsigned long, uint8_t);
+};
+
+#endif /* Print_h */
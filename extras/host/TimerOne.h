@@ -0,0 +1,44 @@
+/*
+ * TimerOne.h
+ *
+ * Host stand-in for https://www.pjrc.com/teensy/td_libs_TimerOne.html on
+ * the simulated Timer1, see host.h.
+ */
+
+#ifndef TimerOne_h_
+#define TimerOne_h_
+
+#include "host.h"
+
+class TimerOne {
+ public:
+  void initialize(unsigned long microseconds = 1000000) {
+    period = microseconds;
+    host_timer1_set(period, isr);
+  }
+  void setPeriod(unsigned long microseconds) {
+    period = microseconds;
+    host_timer1_period(period);
+  }
+  void start(void) { host_timer1_restart(); }
+  void stop(void) { host_timer1_stop(); }
+  void restart(void) { host_timer1_restart(); }
+  void resume(void) { host_timer1_resume(); }
+  void attachInterrupt(void (*f)(void), long microseconds = -1) {
+    if (microseconds > 0) period = microseconds;
+    isr = f;
+    host_timer1_set(period, isr);
+  }
+  void detachInterrupt(void) {
+    isr = 0;
+    host_timer1_set(period, isr);
+  }
+
+ private:
+  unsigned long period;
+  void (*isr)(void);
+};
+
+extern TimerOne Timer1;
+
+#endif /* TimerOne_h_ */
@@ -0,0 +1,5 @@
+/*
+ * Wire.h
+ *
+ * Empty host stand-in, the library includes Wire.h but does not use it.
+ */
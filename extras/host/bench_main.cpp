@@ -0,0 +1,13 @@
+/*
+ * bench_main.cpp
+ *
+ * Runs a benchmark sketch from extras/bench on the host: setup() does all
+ * the work and prints the results, loop() is not called.
+ */
+
+void setup(void);
+
+int main(void) {
+    setup();
+    return 0;
+}
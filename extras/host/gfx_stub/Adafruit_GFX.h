@@ -0,0 +1,56 @@
+/*
+ * Adafruit_GFX.h
+ *
+ * Minimal host stand-in for Adafruit_GFX: just what PWMDirectMatrix itself
+ * needs, enough for the tools that drive DirectMatrix directly.
+ * To build sketches that draw with the GFX primitives, point GFX_DIR at a
+ * real copy of https://github.com/adafruit/Adafruit-GFX-Library, which is
+ * then used instead of this file (see Makefile).
+ */
+
+#ifndef _ADAFRUIT_GFX_H
+#define _ADAFRUIT_GFX_H
+
+#include "Arduino.h"
+
+#ifndef swap
+#define swap(a, b) { int16_t t = a; a = b; b = t; }
+#endif
+
+class Adafruit_GFX : public Print {
+ public:
+  Adafruit_GFX(int16_t w, int16_t h) :
+    WIDTH(w), HEIGHT(h), _width(w), _height(h), rotation(0) { }
+  virtual ~Adafruit_GFX() { }
+
+  virtual void drawPixel(int16_t x, int16_t y, uint16_t color) = 0;
+
+  virtual void fillRect(int16_t x, int16_t y, int16_t w, int16_t h,
+			uint16_t color) {
+    for (int16_t i = x; i < x + w; i++)
+      for (int16_t j = y; j < y + h; j++)
+	drawPixel(i, j, color);
+  }
+  virtual void fillScreen(uint16_t color) {
+    fillRect(0, 0, _width, _height, color);
+  }
+
+  void setRotation(uint8_t r) {
+    rotation = (r & 3);
+    if (rotation & 1) { _width = HEIGHT; _height = WIDTH; }
+    else { _width = WIDTH; _height = HEIGHT; }
+  }
+  uint8_t getRotation(void) const { return rotation; }
+  int16_t width(void) const { return _width; }
+  int16_t height(void) const { return _height; }
+
+  size_t write(uint8_t) { return 1; }
+  using Print::write;
+
+ protected:
+  const int16_t WIDTH, HEIGHT;
+  int16_t _width, _height;
+  uint8_t rotation;
+};
+
+#endif /* _ADAFRUIT_GFX_H */
@@ -0,0 +1,321 @@
+/*
+ * host.cpp
+ *
+ * Simulated ATmega328 for host builds, see host.h.
+ */
+
+#include <stdio.h>
+#include <unistd.h>
+#include "Arduino.h"
+#include "TimerOne.h"
+
+uint64_t host_cycles;
+
+HardwareSerial Serial;
+TimerOne Timer1;
+
+// ports are indexed by address - HOST_PORTB (0, 3, 6)
+static uint8_t port_out[9];
+static uint8_t port_ddr[9];
+static uint8_t port_in[9];
+
+static uint8_t irq_enabled = 1;
+static uint8_t in_isr;
+static int serial_fd = 1;
+
+static struct {
+    void (*f)(void);
+    uint64_t period;
+    uint64_t next;
+    uint8_t running;	// guards against f() moving time
+} tick;
+
+#define MAX_LISTENERS 4
+static host_pin_listener_t listeners[MAX_LISTENERS];
+static uint8_t num_listeners;
+
+static struct {
+    void (*isr)(void);
+    uint64_t period;	// in cycles
+    uint64_t last;	// when the last interrupt fired
+    uint64_t next;	// when the next one is due
+    uint64_t left;	// cycles left to next when stopped
+    uint8_t running;
+} timer1;
+
+static const GPIO_pin_t arduino_pins[GPIO_PINS_NUMBER] = {
+    DP0, DP1, DP2, DP3, DP4, DP5, DP6, DP7, DP8, DP9,
+    DP10, DP11, DP12, DP13, DP14, DP15, DP16, DP17, DP18, DP19,
+};
+
+static inline uint8_t port_index(GPIO_pin_t pin) {
+    return ((pin & 0xFF) - HOST_PORTB) % 9;
+}
+
+static inline uint8_t timer1_enabled(void) {
+    return ! in_isr && irq_enabled && timer1.running && timer1.isr;
+}
+
+void host_poll(void) {
+    for (;;)
+    {
+	if (tick.f && ! tick.running && host_cycles >= tick.next)
+	{
+	    tick.running = 1;
+	    tick.next += tick.period;
+	    tick.f();
+	    tick.running = 0;
+	    continue;
+	}
+	if (timer1_enabled() && host_cycles >= timer1.next)
+	{
+	    in_isr = 1;
+	    timer1.last = timer1.next;
+	    timer1.next = timer1.last + timer1.period;
+	    host_cycles += HOST_CYCLES_ISR_ENTRY;
+	    timer1.isr();
+	    host_cycles += HOST_CYCLES_ISR_EXIT;
+	    in_isr = 0;
+	    // Like the AVR overflow flag, overflows missed while in the ISR
+	    // collapse into a single pending interrupt.
+	    while (timer1.next + timer1.period <= host_cycles)
+		timer1.next += timer1.period;
+	    continue;
+	}
+	break;
+    }
+}
+
+void host_advance(uint32_t cycles) {
+    host_cycles += cycles;
+    host_poll();
+}
+
+// Jump to the given cycle, stopping on the way for the interrupts and
+// periodic callback that are due
+void host_run_until(uint64_t cycle) {
+    while (host_cycles < cycle)
+    {
+	uint64_t next = cycle;
+
+	if (timer1_enabled() && timer1.next < next) next = timer1.next;
+	if (tick.f && ! tick.running && tick.next < next) next = tick.next;
+	if (next > host_cycles) host_cycles = next;
+	host_poll();
+    }
+}
+
+void host_every(uint64_t period, void (*f)(void)) {
+    tick.f = f;
+    tick.period = period;
+    tick.next = host_cycles + period;
+}
+
+void host_serial_fd(int fd) {
+    serial_fd = fd;
+}
+
+uint8_t host_port(uint8_t addr) {
+    return port_out[(addr - HOST_PORTB) % 9];
+}
+
+uint8_t host_ddr(uint8_t addr) {
+    return port_ddr[(addr - HOST_PORTB) % 9];
+}
+
+void host_set_input(uint16_t pin, uint8_t value) {
+    if (value) port_in[port_index(pin)] |= GPIO_PIN_MASK(pin);
+    else port_in[port_index(pin)] &= ~GPIO_PIN_MASK(pin);
+}
+
+uint8_t host_reg_read(uint8_t addr, uint8_t ddr) {
+    uint8_t i = (addr - HOST_PORTB) % 9;
+
+    return ddr ? port_ddr[i] : port_out[i];
+}
+
+void host_reg_write(uint8_t addr, uint8_t ddr, uint8_t value) {
+    uint8_t i = (addr - HOST_PORTB) % 9;
+    uint8_t new_out = ddr ? port_out[i] : value;
+    uint8_t new_ddr = ddr ? value : port_ddr[i];
+    // pins that are or become outputs and change level, or change direction
+    uint8_t changed = ((port_out[i] ^ new_out) & (port_ddr[i] | new_ddr)) |
+		      (port_ddr[i] ^ new_ddr);
+
+    for (uint8_t bit = 0; bit < 8; bit++)
+    {
+	if (! (changed & (1 << bit))) continue;
+	for (uint8_t l = 0; l < num_listeners; l++)
+	    listeners[l](GPIO_MAKE_PINCODE(addr, bit),
+		(new_out & (1 << bit)) ? HIGH : LOW, host_cycles);
+    }
+    port_out[i] = new_out;
+    port_ddr[i] = new_ddr;
+    host_advance(HOST_CYCLES_REG);
+}
+
+void host_add_pin_listener(host_pin_listener_t listener) {
+    if (num_listeners < MAX_LISTENERS) listeners[num_listeners++] = listener;
+}
+
+const char *host_pin_name(uint16_t pin) {
+    static const char *names[GPIO_PINS_NUMBER] = {
+	"D0", "D1", "D2", "D3", "D4", "D5", "D6", "D7", "D8", "D9",
+	"D10", "D11", "D12", "D13", "A0", "A1", "A2", "A3", "A4", "A5",
+    };
+
+    for (uint8_t i = 0; i < GPIO_PINS_NUMBER; i++)
+	if (arduino_pins[i] == pin) return names[i];
+    return "invalid";
+}
+
+uint8_t host_in_isr(void) {
+    return in_isr;
+}
+
+void host_timer1_set(uint32_t period_us, void (*isr)(void)) {
+    timer1.isr = isr;
+    timer1.period = (uint64_t) period_us * HOST_CYCLES_PER_US;
+    timer1.last = host_cycles;
+    timer1.next = host_cycles + timer1.period;
+    timer1.running = 1;
+}
+
+// Like changing ICR1: the interval that started at the last overflow
+// gets the new length.
+void host_timer1_period(uint32_t period_us) {
+    timer1.period = (uint64_t) period_us * HOST_CYCLES_PER_US;
+    timer1.next = timer1.last + timer1.period;
+    if (! in_isr) host_poll();
+}
+
+void host_timer1_stop(void) {
+    if (! timer1.running) return;
+    timer1.running = 0;
+    timer1.left = (timer1.next > host_cycles) ? timer1.next - host_cycles : 0;
+}
+
+void host_timer1_resume(void) {
+    if (timer1.running) return;
+    timer1.running = 1;
+    timer1.next = host_cycles + timer1.left;
+    timer1.last = timer1.next - timer1.period;
+    if (! in_isr) host_poll();
+}
+
+void host_timer1_restart(void) {
+    timer1.running = 1;
+    timer1.last = host_cycles;
+    timer1.next = host_cycles + timer1.period;
+}
+
+// ===========================================================================
+// Arduino core
+// ===========================================================================
+void noInterrupts(void) {
+    irq_enabled = 0;
+}
+
+void interrupts(void) {
+    irq_enabled = 1;
+    host_poll();
+}
+
+unsigned long micros(void) {
+    unsigned long us = host_cycles / HOST_CYCLES_PER_US;
+
+    host_advance(HOST_CYCLES_MICROS);
+    return us;
+}
+
+unsigned long millis(void) {
+    unsigned long ms = host_cycles / (HOST_CYCLES_PER_US * 1000);
+
+    host_advance(HOST_CYCLES_MICROS);
+    return ms;
+}
+
+void delay(unsigned long ms) {
+    host_run_until(host_cycles + (uint64_t) ms * 1000 * HOST_CYCLES_PER_US);
+}
+
+void delayMicroseconds(unsigned int us) {
+    host_run_until(host_cycles + (uint64_t) us * HOST_CYCLES_PER_US);
+}
+
+long random(long howbig) {
+    if (howbig == 0) return 0;
+    return rand() % howbig;
+}
+
+long random(long howsmall, long howbig) {
+    if (howsmall >= howbig) return howsmall;
+    return random(howbig - howsmall) + howsmall;
+}
+
+void randomSeed(unsigned long seed) {
+    srand(seed);
+}
+
+GPIO_pin_t Arduino_to_GPIO_pin(uint8_t pin) {
+    if (pin < GPIO_PINS_NUMBER) return arduino_pins[pin];
+    return DP_INVALID;
+}
+
+void pinMode2f(GPIO_pin_t pin, uint8_t mode) {
+    uint8_t mask = GPIO_PIN_MASK(pin);
+    uint8_t i = port_index(pin);
+
+    if (mode == OUTPUT)
+    {
+	port_ddr[i] |= mask;
+    }
+    else
+    {
+	port_ddr[i] &= ~mask;
+	if (mode == INPUT_PULLUP) port_out[i] |= mask;
+	else port_out[i] &= ~mask;
+    }
+    host_advance(HOST_CYCLES_WRITE);
+}
+
+void digitalWrite2f(GPIO_pin_t pin, uint8_t value) {
+    uint8_t mask = GPIO_PIN_MASK(pin);
+    uint8_t i = port_index(pin);
+    uint8_t val = value ? port_out[i] | mask : port_out[i] & ~mask;
+
+    if (val != port_out[i] && (port_ddr[i] & mask))
+    {
+	for (uint8_t l = 0; l < num_listeners; l++)
+	    listeners[l](pin, value ? HIGH : LOW, host_cycles);
+    }
+    port_out[i] = val;
+    host_advance(HOST_CYCLES_WRITE);
+}
+
+uint8_t digitalRead2f(GPIO_pin_t pin) {
+    uint8_t mask = GPIO_PIN_MASK(pin);
+    uint8_t i = port_index(pin);
+    uint8_t value;
+
+    if (port_ddr[i] & mask) value = port_out[i] & mask;
+    else value = port_in[i] & mask;
+    host_advance(HOST_CYCLES_READ);
+    return value ? HIGH : LOW;
+}
+
+void pinMode(uint8_t pin, uint8_t mode) {
+    pinMode2f(Arduino_to_GPIO_pin(pin), mode);
+}
+
+void digitalWrite(uint8_t pin, uint8_t value) {
+    digitalWrite2f(Arduino_to_GPIO_pin(pin), value);
+}
+
+int digitalRead(uint8_t pin) {
+    return digitalRead2f(Arduino_to_GPIO_pin(pin));
+}
+
+size_t HardwareSerial::write(uint8_t c) {
+    return ::write(serial_fd, &c, 1);
+}
@@ -0,0 +1,87 @@
+/*
+ * host.h
+ *
+ * Host (Linux/Mac) stand-in for the bits of an ATmega328 the library uses:
+ * a simulated 16MHz cycle counter, PORTB/C/D, Timer1 and its interrupt.
+ * The library, examples and tools compile unmodified against Arduino.h in
+ * this directory, and digitalWrite2f/pinMode2f update the simulated ports
+ * and notify listeners (VCD writer, renderer...) with a cycle timestamp.
+ *
+ * Time only moves when the program does something: each GPIO access,
+ * micros()/millis() call and ISR entry/exit costs the number of cycles
+ * below, and delay() jumps ahead. Due timer interrupts are run whenever
+ * time moves and interrupts are enabled.
+ */
+
+#ifndef HOST_H_
+#define HOST_H_
+
+#include <stdint.h>
+
+#define HOST_F_CPU 16000000UL
+#define HOST_CYCLES_PER_US (HOST_F_CPU / 1000000UL)
+
+// Approximate costs in CPU cycles. We don't simulate instructions, so the
+// cost of a GPIO write includes the code around it in the scan loop
+// (framebuffer read, bit test, loop). It is calibrated against the ISR
+// runtime measured on a Nano (see DirectMatrix_RefreshPWMLine): 104us for
+// 8 direct + 8 SR columns, which is 36 writes.
+#ifndef HOST_CYCLES_WRITE
+#define HOST_CYCLES_WRITE 44	// digitalWrite2f/pinMode2f
+#endif
+#define HOST_CYCLES_READ 16	// digitalRead2f
+#define HOST_CYCLES_REG 3	// GPIO_PORT_REG()/GPIO_DDR_REG() read-modify-write
+#define HOST_CYCLES_MICROS 48	// micros()/millis()
+#define HOST_CYCLES_ISR_ENTRY 60	// vector, register save, TimerOne dispatch
+#define HOST_CYCLES_ISR_EXIT 40
+
+// Port register addresses, same as pins2_arduino.h
+#define HOST_PORTB 0x25
+#define HOST_PORTC 0x28
+#define HOST_PORTD 0x2B
+
+extern uint64_t host_cycles;
+
+// Move simulated time forward, running the timer ISR when due
+void host_advance(uint32_t cycles);
+// Run the timer ISR if due (called when interrupts get enabled)
+void host_poll(void);
+// Same as delay, in cycles: time moves, interrupts run
+void host_run_until(uint64_t cycle);
+
+// Call f every period cycles of simulated time, whatever the program is
+// doing (renderers, time limits...). f must not advance time itself.
+void host_every(uint64_t period, void (*f)(void));
+// Where Serial output goes, stdout by default
+void host_serial_fd(int fd);
+
+// Output port and DDR values, indexed by port address
+uint8_t host_port(uint8_t addr);
+uint8_t host_ddr(uint8_t addr);
+// Drive an input pin from the simulation (buttons, sense lines...)
+void host_set_input(uint16_t pin, uint8_t value);
+
+// Called for every output pin change, just before the port changes so that
+// host_port() still has the old value. Register writes (GPIO_DDR_REG...)
+// also call it when a pin changes direction, with its new output value.
+typedef void (*host_pin_listener_t)(uint16_t pin, uint8_t value,
+				    uint64_t cycle);
+void host_add_pin_listener(host_pin_listener_t);
+
+// Whole register access for GPIO_PORT_REG()/GPIO_DDR_REG(), addr is the
+// PORTx address
+uint8_t host_reg_read(uint8_t addr, uint8_t ddr);
+void host_reg_write(uint8_t addr, uint8_t ddr, uint8_t value);
+
+// Pin code <-> name helpers ("D13", "A0"...)
+const char *host_pin_name(uint16_t pin);
+
+// Timer1, driven by the TimerOne stand-in
+void host_timer1_set(uint32_t period_us, void (*isr)(void));
+void host_timer1_period(uint32_t period_us);
+void host_timer1_stop(void);
+void host_timer1_resume(void);
+void host_timer1_restart(void);
+uint8_t host_in_isr(void);
+
+#endif /* HOST_H_ */
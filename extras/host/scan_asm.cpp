@@ -0,0 +1,163 @@
+/*
+ * scan_asm.cpp
+ *
+ * Compile the scan program (see DirectMatrix::compileScan()) for the
+ * example wirings, disassemble it and estimate what it costs per row on an
+ * ATmega328, next to the pin array path, to compare wirings offline.
+ *
+ * Usage: scan_asm [-w wiring] [-q]
+ * - wiring: one of the example wirings (mono, bicolor, tricolor), default
+ *   all of them
+ * - q: only the summary, no disassembly
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "LED_Matrix.h"
+#include "wirings.h"
+
+extern DirectMatrix_scan_op_t * volatile DirectMatrix_SCAN;
+
+// Rough AVR cycles of the scan program interpreter (avr-gcc -Os): loop and
+// step fetch, port read-modify-write, pixel test, and the row steps that
+// go through digitalWrite2f with a variable pin.
+#define CYCLES_STEP 14
+#define CYCLES_WRITE 10
+#define CYCLES_PIXEL 16
+#define CYCLES_ROW 24
+// A digitalWrite2f in the pin array path, with the loop around it, as
+// calibrated on a Nano (see host.h)
+#define CYCLES_PIN_ARRAY_WRITE 44
+
+static const char *color_names[] = { "c0", "c1", "c2" };
+
+static void usage(void) {
+    fprintf(stderr, "usage: scan_asm [-w wiring] [-q]\nwirings:");
+    host_list_wirings();
+    exit(1);
+}
+
+static const char *port_name(uint8_t port) {
+    switch (port)
+    {
+    case HOST_PORTB: return "PORTB";
+    case HOST_PORTC: return "PORTC";
+    case HOST_PORTD: return "PORTD";
+    }
+    return "PORT?";
+}
+
+// The pins of a port mask, by name
+static void pin_names(uint8_t port, uint8_t mask, char *out, size_t size) {
+    out[0] = 0;
+    for (uint8_t bit = 0; bit < 8; bit++)
+    {
+	if (! (mask & (1 << bit))) continue;
+	size_t used = strlen(out);
+	snprintf(out + used, size - used, "%s%s", used ? " " : "",
+		 host_pin_name(GPIO_MAKE_PINCODE(port, bit)));
+    }
+}
+
+static uint32_t step_cycles(const DirectMatrix_scan_op_t *op) {
+    switch (op->op & 0x0F)
+    {
+    case DirectMatrix_OP_PIXEL:
+	return CYCLES_STEP + CYCLES_PIXEL + CYCLES_WRITE;
+    case DirectMatrix_OP_OLD_ROW:
+    case DirectMatrix_OP_ROW:
+	return CYCLES_STEP + CYCLES_ROW;
+    }
+    return CYCLES_STEP + CYCLES_WRITE;
+}
+
+static void disassemble(uint16_t len) {
+    for (uint16_t i = 0; i < len; i++)
+    {
+	const DirectMatrix_scan_op_t *op = &DirectMatrix_SCAN[i];
+	char pins[64];
+
+	printf("  %3u: ", i);
+	pin_names(op->port, op->mask, pins, sizeof(pins));
+	switch (op->op & 0x0F)
+	{
+	case DirectMatrix_OP_OLD_ROW:
+	    printf("old row off\n");
+	    continue;
+	case DirectMatrix_OP_ROW:
+	    printf("row on\n");
+	    continue;
+	case DirectMatrix_OP_PIXEL:
+	    printf("%s[%02x] = %s col %2u ? %02x : %02x", port_name(op->port),
+		   op->mask, color_names[op->op >> 4], op->col, op->lit, 
+		   op->dark);
+	    break;
+	default:
+	    printf("%s[%02x] = %02x%17s", port_name(op->port), op->mask, 
+		   op->lit, "");
+	}
+	printf("    ; %s\n", pins);
+    }
+}
+
+// digitalWrite2f calls of the pin array path for one row
+static uint32_t pin_array_writes(host_wiring *w) {
+    uint32_t writes = 2;	// rows
+
+    for (uint8_t c = 0; c < w->colors; c++)
+	writes += (w->sr[c] == DINV) ? 8 : 3 * 8 + 2;
+    return writes;
+}
+
+static void compile(host_wiring *w, uint8_t quiet) {
+    DirectMatrix matrix(8, 8, w->colors, w->common);
+    uint32_t cycles = 0;
+    uint32_t writes = 0;
+
+    matrix.begin(w->rows, w->cols, w->sr, w->isr_freq);
+    uint16_t len = matrix.compileScan();
+
+    for (uint16_t i = 0; i < len; i++)
+    {
+	cycles += step_cycles(&DirectMatrix_SCAN[i]);
+	if ((DirectMatrix_SCAN[i].op & 0x0F) <= DirectMatrix_OP_PIXEL) writes++;
+    }
+    printf("%s: %u steps (%u bytes), %u port writes\n", w->name, len,
+	   (unsigned) (len * sizeof(DirectMatrix_scan_op_t)), writes);
+    if (! quiet) disassemble(len);
+    uint32_t pins = pin_array_writes(w) * CYCLES_PIN_ARRAY_WRITE;
+    printf("  per row: ~%u cycles (%.1fus), pin arrays ~%u cycles (%.1fus)\n\n",
+	   cycles, cycles / 16.0, pins, pins / 16.0);
+}
+
+int main(int argc, char **argv) {
+    const char *name = NULL;
+    uint8_t quiet = 0;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "w:q")) != -1)
+    {
+	switch (opt)
+	{
+	case 'w':
+	    name = optarg;
+	    break;
+	case 'q':
+	    quiet = 1;
+	    break;
+	default:
+	    usage();
+	}
+    }
+
+    for (host_wiring *w = host_wirings; w->name; w++)
+    {
+	if (name && strcmp(name, w->name)) continue;
+	compile(w, quiet);
+	if (name) return 0;
+    }
+    if (name) usage();
+    return 0;
+}
@@ -0,0 +1,245 @@
+/*
+ * scan_ghost.cpp
+ *
+ * Measure ghosting on the simulated ATmega328 for given row and column
+ * driver turn-off delays, with each of the library's ghosting options
+ * (DirectMatrix::preBlank(), DirectMatrix::deadTime()).
+ *
+ * Usage: scan_ghost [-w wiring] [-r row_us] [-c col_us] [-d dead_us] [-t ms]
+ * - wiring: one of the example wirings (mono, bicolor, tricolor)
+ * - row_us: how long a row keeps conducting after its pin goes off, the
+ *   slow turn-off of a transistor or driver (default 10us)
+ * - col_us: same for columns and shift register outputs (default 10us)
+ * - dead_us: dead time to try, default row_us
+ * - ms: simulated time per option, default 200ms
+ *
+ * The pattern has the even rows fully lit and the odd rows off, so that
+ * every row switch goes from lit columns to dark ones or back. For each
+ * option it prints the ghosting (mean energy of the dark LEDs over the lit
+ * ones), the brightness of the lit LEDs relative to no option, and the
+ * ISR runtime, CPU load and overruns reported by the library. All 4 BCM
+ * planes are scanned (no adaptiveScan()), as for a frame with levels.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "LED_Matrix.h"
+#include "wirings.h"
+
+// What the library was configured with, from LED_Matrix.cpp
+extern volatile uint8_t ROW_ON;
+extern volatile uint8_t COL_ON;
+extern volatile uint8_t DirectMatrix_NUM_COLORS;
+extern volatile GPIO_pin_t *DirectMatrix_ROW_PINS;
+extern volatile GPIO_pin_t *DirectMatrix_COL_PINS[3];
+extern volatile GPIO_pin_t *DirectMatrix_SR_PINS;
+
+// Cycles each LED conducted
+static uint64_t lit_cycles[8][8][3];
+static uint64_t last_event;
+
+// Driver model: a row or column conducts as soon as its pin turns it on,
+// and until off_at + delay after the pin turns it off.
+static uint64_t row_delay, col_delay;
+static uint8_t row_on[8];
+static uint64_t row_off_at[8];
+static uint8_t col_on[3][8];
+static uint64_t col_off_at[3][8];
+
+// 74HC595 model, same as sketch_run.cpp
+static uint16_t sr_shift;
+static uint16_t sr_latched[3];
+
+static void usage(void) {
+    fprintf(stderr, "usage: scan_ghost [-w wiring] [-r row_us] [-c col_us] "
+	"[-d dead_us] [-t ms]\nwirings:");
+    host_list_wirings();
+    exit(1);
+}
+
+static inline uint8_t pin_level(GPIO_pin_t pin) {
+    return (host_port(pin & 0xFF) & GPIO_PIN_MASK(pin)) ? HIGH : LOW;
+}
+
+static inline GPIO_pin_t latch_pin(uint8_t color, uint8_t *reversed) {
+    GPIO_pin_t latch = DirectMatrix_SR_PINS[color];
+
+    *reversed = latch > 32768;
+    return *reversed ? (GPIO_pin_t) -latch : latch;
+}
+
+// Is column col of this color driven to COL_ON?
+static uint8_t column_on(uint8_t color, uint8_t col) {
+    uint8_t reversed;
+
+    if (DirectMatrix_SR_PINS[color] == DINV)
+	return pin_level(DirectMatrix_COL_PINS[color][col]) == COL_ON;
+    latch_pin(color, &reversed);
+    uint8_t bit = reversed ? col : 7 - col;
+    return ((sr_latched[color] >> bit) & 1) == COL_ON;
+}
+
+// End of the conduction of a driver in [from, ...): it conducts over a
+// prefix of any interval, since it only ever turns off after the pin did.
+static inline uint64_t conducts_until(uint8_t on, uint64_t off_at,
+				      uint64_t delay, uint64_t to) {
+    if (on) return to;
+    return off_at + delay < to ? off_at + delay : to;
+}
+
+// Pick up the pin changes made at last_event (listeners are called before
+// the change), then add the time until now to the LEDs that conducted.
+static void integrate(uint64_t now) {
+    uint64_t from = last_event;
+
+    for (uint8_t row = 0; row < 8; row++)
+    {
+	uint8_t on = pin_level(DirectMatrix_ROW_PINS[row]) == ROW_ON;
+	if (row_on[row] && ! on) row_off_at[row] = from;
+	row_on[row] = on;
+    }
+    for (uint8_t color = 0; color < DirectMatrix_NUM_COLORS; color++)
+	for (uint8_t col = 0; col < 8; col++)
+	{
+	    uint8_t on = column_on(color, col);
+	    if (col_on[color][col] && ! on) col_off_at[color][col] = from;
+	    col_on[color][col] = on;
+	}
+
+    last_event = now;
+    if (now == from) return;
+    for (uint8_t row = 0; row < 8; row++)
+    {
+	uint64_t row_end = conducts_until(row_on[row], row_off_at[row],
+					  row_delay, now);
+	if (row_end <= from) continue;
+	for (uint8_t color = 0; color < DirectMatrix_NUM_COLORS; color++)
+	    for (uint8_t col = 0; col < 8; col++)
+	    {
+		uint64_t end = conducts_until(col_on[color][col],
+			col_off_at[color][col], col_delay, row_end);
+		if (end > from) lit_cycles[row][col][color] += end - from;
+	    }
+    }
+}
+
+static void pin_changed(uint16_t pin, uint8_t value, uint64_t cycle) {
+    if (! DirectMatrix_ROW_PINS) return;
+    integrate(cycle);
+
+    if (DirectMatrix_SR_PINS[DATA] == DINV || ! value) return;
+    if (pin == DirectMatrix_SR_PINS[CLK])
+    {
+	sr_shift = (sr_shift << 1) | pin_level(DirectMatrix_SR_PINS[DATA]);
+	return;
+    }
+    for (uint8_t color = 0; color < DirectMatrix_NUM_COLORS; color++)
+    {
+	uint8_t reversed;
+	if (DirectMatrix_SR_PINS[color] == DINV) continue;
+	if (pin == latch_pin(color, &reversed)) sr_latched[color] = sr_shift;
+    }
+}
+
+// Run one option for ms and print its line, brightness is relative to
+// *lit_ref (set by the first option).
+static void run_option(PWMDirectMatrix *matrix, const char *name,
+	uint8_t pre_blank, uint8_t dead_time, uint32_t ms, double *lit_ref) {
+    double lit = 0, dark = 0;
+    uint16_t lit_leds = 0, dark_leds = 0;
+    uint32_t overruns;
+
+    matrix->preBlank(pre_blank);
+    matrix->deadTime(dead_time);
+    // one frame to settle, then measure
+    host_run_until(host_cycles + 20000UL * HOST_CYCLES_PER_US);
+    integrate(host_cycles);
+    memset(lit_cycles, 0, sizeof(lit_cycles));
+    overruns = matrix->ISR_overruns();
+    host_run_until(host_cycles + (uint64_t) ms * 1000 * HOST_CYCLES_PER_US);
+    integrate(host_cycles);
+    overruns = matrix->ISR_overruns() - overruns;
+
+    for (uint8_t row = 0; row < 8; row++)
+	for (uint8_t col = 0; col < 8; col++)
+	    for (uint8_t c = 0; c < DirectMatrix_NUM_COLORS; c++)
+	    {
+		if (row & 1)
+		{
+		    dark += lit_cycles[row][col][c];
+		    dark_leds++;
+		}
+		else
+		{
+		    lit += lit_cycles[row][col][c];
+		    lit_leds++;
+		}
+	    }
+    lit /= lit_leds;
+    dark /= dark_leds;
+    if (! *lit_ref) *lit_ref = lit;
+
+    printf("%-18s %7.3f%% %9.1f%% %8luus %5d%% %9lu\n", name,
+	100 * dark / lit, 100 * lit / *lit_ref,
+	(unsigned long) matrix->ISR_runtime(), matrix->cpuLoad(),
+	(unsigned long) overruns);
+}
+
+int main(int argc, char **argv) {
+    host_wiring *w = host_find_wiring("bicolor");
+    uint32_t row_us = 10, col_us = 10, ms = 200;
+    int dead_us = -1;
+    double lit_ref = 0;
+    char name[32];
+    int opt;
+
+    while ((opt = getopt(argc, argv, "w:r:c:d:t:")) != -1)
+    {
+	switch (opt)
+	{
+	case 'w':
+	    if (! (w = host_find_wiring(optarg))) usage();
+	    break;
+	case 'r':
+	    row_us = atoi(optarg);
+	    break;
+	case 'c':
+	    col_us = atoi(optarg);
+	    break;
+	case 'd':
+	    dead_us = atoi(optarg);
+	    break;
+	case 't':
+	    ms = atoi(optarg);
+	    break;
+	default:
+	    usage();
+	}
+    }
+    if (dead_us < 0) dead_us = row_us;
+    if (dead_us > 255) usage();
+    row_delay = row_us * HOST_CYCLES_PER_US;
+    col_delay = col_us * HOST_CYCLES_PER_US;
+
+    PWMDirectMatrix *matrix = new PWMDirectMatrix(8, 8, w->colors, w->common);
+    matrix->clear();
+    for (uint8_t y = 0; y < 8; y += 2)
+	for (uint8_t x = 0; x < 8; x++)
+	    matrix->drawPixel(x, y, 0xfff);
+    host_add_pin_listener(pin_changed);
+    matrix->begin(w->rows, w->cols, w->sr, w->isr_freq);
+    matrix->writeDisplay();
+
+    printf("# %s wiring, drivers off after %uus (rows) %uus (columns)\n",
+	w->name, row_us, col_us);
+    printf("# option              ghost brightness  ISR time  load  overruns\n");
+    run_option(matrix, "none", 0, 0, ms, &lit_ref);
+    run_option(matrix, "preblank", 1, 0, ms, &lit_ref);
+    snprintf(name, sizeof(name), "dead %dus", dead_us);
+    run_option(matrix, name, 0, dead_us, ms, &lit_ref);
+    snprintf(name, sizeof(name), "preblank+dead %dus", dead_us);
+    run_option(matrix, name, 1, dead_us, ms, &lit_ref);
+    return 0;
+}
@@ -0,0 +1,120 @@
+/*
+ * scan_vcd.cpp
+ *
+ * Run the DirectMatrix scan on the simulated ATmega328 and write the row,
+ * column, shift register clock/data and latch waveforms to a VCD file.
+ *
+ * Usage: scan_vcd [-w wiring] [-t ms] [-p pattern] [-o out.vcd]
+ * - wiring: one of the example wirings (mono, bicolor, tricolor)
+ * - ms: how much time to simulate after begin(), default 30ms (> 1 frame)
+ * - pattern: gradient (all 16 levels on every color, default), full, off
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "LED_Matrix.h"
+#include "wirings.h"
+#include "vcd.h"
+
+static void usage(void) {
+    fprintf(stderr, "usage: scan_vcd [-w wiring] [-t ms] [-p gradient|full|off] "
+	"[-o out.vcd]\nwirings:");
+    host_list_wirings();
+    exit(1);
+}
+
+// Give each pin a name according to what it drives
+static void name_pins(host_wiring *w) {
+    char name[16];
+
+    for (uint8_t r = 0; r < 8; r++)
+    {
+	snprintf(name, sizeof(name), "row%d", r);
+	vcd_pin(w->rows[r], name, "rows");
+    }
+    for (uint8_t c = 0; c < w->colors; c++)
+    {
+	if (w->sr[c] == DINV)
+	{
+	    for (uint8_t col = 0; col < 8; col++)
+	    {
+		snprintf(name, sizeof(name), "c%d_col%d", c, col);
+		vcd_pin(w->cols[c * 8 + col], name, "columns");
+	    }
+	}
+	else
+	{
+	    GPIO_pin_t latch = w->sr[c];
+	    if (latch > 32768) latch = (GPIO_pin_t) -latch;
+	    snprintf(name, sizeof(name), "latch%d", c);
+	    vcd_pin(latch, name, "sr");
+	}
+    }
+    vcd_pin(w->sr[DATA], "data", "sr");
+    vcd_pin(w->sr[CLK], "clk", "sr");
+}
+
+int main(int argc, char **argv) {
+    const char *out = "scan.vcd";
+    const char *pattern = "gradient";
+    host_wiring *w = host_find_wiring("bicolor");
+    uint32_t ms = 30;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "w:t:p:o:")) != -1)
+    {
+	switch (opt)
+	{
+	case 'w':
+	    if (! (w = host_find_wiring(optarg))) usage();
+	    break;
+	case 't':
+	    ms = atoi(optarg);
+	    break;
+	case 'p':
+	    pattern = optarg;
+	    break;
+	case 'o':
+	    out = optarg;
+	    break;
+	default:
+	    usage();
+	}
+    }
+
+    if (vcd_open(out))
+    {
+	perror(out);
+	return 1;
+    }
+    name_pins(w);
+
+    PWMDirectMatrix *matrix = new PWMDirectMatrix(8, 8, w->colors, w->common);
+    matrix->clear();
+    for (uint8_t y = 0; y < 8; y++)
+    {
+	for (uint8_t x = 0; x < 8; x++)
+	{
+	    uint16_t level = 0;
+	    if (! strcmp(pattern, "gradient")) level = (y * 8 + x) / 4;
+	    else if (! strcmp(pattern, "full")) level = 15;
+	    else if (strcmp(pattern, "off")) usage();
+	    matrix->drawPixel(x, y, level | level << 4 | level << 8);
+	}
+    }
+    matrix->begin(w->rows, w->cols, w->sr, w->isr_freq);
+    matrix->writeDisplay();
+
+    vcd_start();
+    host_run_until(host_cycles + (uint64_t) ms * 1000 * HOST_CYCLES_PER_US);
+    vcd_close();
+
+    fprintf(stderr, "%s: %s wiring, %ums simulated, ISR runtime %luus, "
+	"CPU load %d%%, frame %luus, %lu overruns, quality level %d\n", 
+	out, w->name, ms, (unsigned long) matrix->ISR_runtime(), 
+	matrix->cpuLoad(), (unsigned long) matrix->frameTime(),
+	(unsigned long) matrix->ISR_overruns(), matrix->quality());
+    return 0;
+}
@@ -0,0 +1,326 @@
+/*
+ * sketch_run.cpp
+ *
+ * Run an Arduino sketch (e.g. one of the examples) on the simulated
+ * ATmega328 and show what the matrix looks like: the time each LED spends
+ * lit is integrated from the simulated row/column/shift register pins, and
+ * rendered to a truecolor terminal or to PPM images.
+ *
+ * Usage: run_<sketch> [-t seconds] [-f fps] [-o ppm_prefix] [-n]
+ * - seconds: simulated time to run for, default 10
+ * - fps: rendered frames per simulated second, default 25
+ * - ppm_prefix: write <prefix>00000.ppm... instead of drawing in the terminal
+ * - n: do not pace the terminal output to real time
+ * Serial output from the sketch goes to stderr.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <math.h>
+#include <time.h>
+#include "LED_Matrix.h"
+
+void setup(void);
+void loop(void);
+
+// What the library was configured with, from LED_Matrix.cpp
+extern volatile uint8_t ROW_ON;
+extern volatile uint8_t COL_ON;
+extern volatile uint8_t DirectMatrix_ARRAY_ROWS;
+extern volatile uint8_t DirectMatrix_ARRAY_COLS;
+extern volatile uint8_t DirectMatrix_NUM_COLORS;
+extern volatile GPIO_pin_t *DirectMatrix_ROW_PINS;
+extern volatile GPIO_pin_t *DirectMatrix_COL_PINS[3];
+extern volatile GPIO_pin_t *DirectMatrix_SR_PINS;
+extern volatile uint32_t DirectMatrix_FRAME_TIME;
+extern volatile uint32_t DirectMatrix_FRAME_BUSY;
+extern volatile uint8_t DirectMatrix_CHARLIE;
+extern volatile uint8_t DirectMatrix_MOCK;
+extern volatile uint32_t DirectMatrix_MOCK_COLS[3];
+extern volatile uint8_t DirectMatrix_HUB75;
+extern volatile uint8_t DirectMatrix_HUB75_ADDR_LINES;
+extern volatile GPIO_pin_t *DirectMatrix_HUB75_PINS;
+
+#define MAX_SIZE 32
+#define PPM_SCALE 16	// pixels per LED in PPM output
+
+// Cycles each LED was lit since the last rendered frame
+static uint64_t lit_cycles[MAX_SIZE][MAX_SIZE][3];
+static uint64_t last_event;
+static uint64_t last_render;
+
+// 74HC595 model: one shift register (DATA and CLK are shared by all colors)
+// and one output latch per color.
+static uint16_t sr_shift;
+static uint16_t sr_latched[3];
+
+// HUB75 panel model: one column shift register per R1 G1 B1 R2 G2 B2 input
+// (index 0 is column 0, the last bit shifted) and their output latches.
+static uint8_t hub75_shift[6][MAX_SIZE];
+static uint8_t hub75_latched[6][MAX_SIZE];
+
+static const char *ppm_prefix;
+static uint8_t realtime = 1;
+static uint32_t frames;
+static uint64_t end_cycle;
+
+static inline uint8_t pin_level(GPIO_pin_t pin) {
+    return (host_port(pin & 0xFF) & GPIO_PIN_MASK(pin)) ? HIGH : LOW;
+}
+
+static inline GPIO_pin_t latch_pin(uint8_t color, uint8_t *reversed) {
+    GPIO_pin_t latch = DirectMatrix_SR_PINS[color];
+
+    *reversed = latch > 32768;
+    return *reversed ? (GPIO_pin_t) -latch : latch;
+}
+
+// Charlieplexing: is the pin an output at this level?
+static inline uint8_t pin_driven(GPIO_pin_t pin, uint8_t level) {
+    if (! (host_ddr(pin & 0xFF) & GPIO_PIN_MASK(pin))) return 0;
+    return pin_level(pin) == level;
+}
+
+// Is column col of this color driven to COL_ON?
+static uint8_t column_on(uint8_t color, uint8_t col) {
+    uint8_t cols = DirectMatrix_ARRAY_COLS;
+    uint8_t reversed;
+
+    // DirectMatrix_MockOutput: no pins, the ISR only changes these between
+    // the row going off and on again, so the row pins still time it.
+    if (DirectMatrix_MOCK & (1 << color))
+	return (DirectMatrix_MOCK_COLS[color] >> col) & 1;
+    if (DirectMatrix_SR_PINS[color] == DINV)
+	return pin_level(DirectMatrix_COL_PINS[color][col]) == COL_ON;
+
+    // The ISR shifts column 0 first, or last for reversed shift registers,
+    // sr_shift bit 0 is the last bit shifted.
+    latch_pin(color, &reversed);
+    uint8_t bit = reversed ? col : cols - 1 - col;
+    return ((sr_latched[color] >> bit) & 1) == COL_ON;
+}
+
+// Add the time since the last pin change to the LEDs that were lit
+static void integrate(uint64_t now) {
+    uint64_t dt = now - last_event;
+
+    last_event = now;
+    if (! DirectMatrix_ROW_PINS || ! dt) return;
+    if (DirectMatrix_HUB75)
+    {
+	uint8_t line = 0;
+	uint8_t lines = DirectMatrix_ARRAY_ROWS;
+
+	if (pin_level(DirectMatrix_HUB75_PINS[HUB75_OE])) return;
+	for (uint8_t i = 0; i < DirectMatrix_HUB75_ADDR_LINES; i++)
+	    line |= pin_level(DirectMatrix_ROW_PINS[i]) << i;
+	if (line >= lines) return;
+	for (uint8_t col = 0; col < DirectMatrix_ARRAY_COLS; col++)
+	    for (uint8_t c = 0; c < 3; c++)
+	    {
+		if (hub75_latched[c][col]) lit_cycles[line][col][c] += dt;
+		if (hub75_latched[c + 3][col]) 
+		    lit_cycles[line + lines][col][c] += dt;
+	    }
+	return;
+    }
+    if (DirectMatrix_CHARLIE)
+    {
+	// LED (col, row) goes from the row pin to the col-th other pin
+	for (uint8_t row = 0; row < DirectMatrix_ARRAY_ROWS; row++)
+	{
+	    if (! pin_driven(DirectMatrix_ROW_PINS[row], HIGH)) continue;
+	    for (uint8_t col = 0; col < DirectMatrix_ARRAY_COLS; col++)
+	    {
+		uint8_t cathode = col < row ? col : col + 1;
+		if (pin_driven(DirectMatrix_ROW_PINS[cathode], LOW))
+		    lit_cycles[row][col][0] += dt;
+	    }
+	}
+	return;
+    }
+    for (uint8_t row = 0; row < DirectMatrix_ARRAY_ROWS; row++)
+    {
+	if (pin_level(DirectMatrix_ROW_PINS[row]) != ROW_ON) continue;
+	for (uint8_t color = 0; color < DirectMatrix_NUM_COLORS; color++)
+	    for (uint8_t col = 0; col < DirectMatrix_ARRAY_COLS; col++)
+		if (column_on(color, col)) lit_cycles[row][col][color] += dt;
+    }
+}
+
+// Called before each pin change is applied: account for the time spent in
+// the old state, then track the shift registers.
+static void pin_changed(uint16_t pin, uint8_t value, uint64_t cycle) {
+    if (! DirectMatrix_ROW_PINS) return;
+    integrate(cycle);
+
+    if (DirectMatrix_CHARLIE) return;
+    if (DirectMatrix_HUB75)
+    {
+	if (! value) return;
+	if (pin == DirectMatrix_HUB75_PINS[HUB75_CLK])
+	{
+	    for (uint8_t c = 0; c < 6; c++)
+	    {
+		memmove(hub75_shift[c] + 1, hub75_shift[c], MAX_SIZE - 1);
+		hub75_shift[c][0] = pin_level(DirectMatrix_COL_PINS[0][c]);
+	    }
+	}
+	else if (pin == DirectMatrix_HUB75_PINS[HUB75_LAT])
+	{
+	    // the panel input is at column 0, so the first bit shifted in
+	    // ends up at the far end
+	    memcpy(hub75_latched, hub75_shift, sizeof(hub75_latched));
+	}
+	return;
+    }
+    if (DirectMatrix_SR_PINS[DATA] == DINV || ! value) return;
+    if (pin == DirectMatrix_SR_PINS[CLK])
+    {
+	sr_shift = (sr_shift << 1) | pin_level(DirectMatrix_SR_PINS[DATA]);
+	return;
+    }
+    for (uint8_t color = 0; color < DirectMatrix_NUM_COLORS; color++)
+    {
+	uint8_t reversed;
+	if (DirectMatrix_SR_PINS[color] == DINV) continue;
+	if (pin == latch_pin(color, &reversed)) sr_latched[color] = sr_shift;
+    }
+}
+
+// Linear light to an sRGB byte
+static uint8_t to_srgb(double v) {
+    if (v <= 0) return 0;
+    if (v >= 1) return 255;
+    return 255 * (v <= 0.0031308 ? 12.92 * v : 1.055 * pow(v, 1 / 2.4) - 0.055);
+}
+
+static void render(void) {
+    uint8_t rows = DirectMatrix_ARRAY_ROWS;
+    // HUB75: the ISR scans lines of 2 rows
+    uint8_t scan = rows;
+    uint8_t cols = DirectMatrix_ARRAY_COLS;
+    uint64_t span = host_cycles - last_render;
+    uint8_t rgb[MAX_SIZE][MAX_SIZE][3];
+
+    integrate(host_cycles);
+    last_render = host_cycles;
+    if (! rows || ! span) return;
+    if (DirectMatrix_HUB75) rows *= 2;
+
+    // An LED lit 1/scan of the time is at full brightness
+    memset(rgb, 0, sizeof(rgb));
+    for (uint8_t y = 0; y < rows; y++)
+	for (uint8_t x = 0; x < cols; x++)
+	    for (uint8_t c = 0; c < DirectMatrix_NUM_COLORS; c++)
+		rgb[y][x][c] = to_srgb((double) lit_cycles[y][x][c] * scan / span);
+    memset(lit_cycles, 0, sizeof(lit_cycles));
+
+    if (ppm_prefix)
+    {
+	char name[256];
+	snprintf(name, sizeof(name), "%s%05u.ppm", ppm_prefix, frames);
+	FILE *f = fopen(name, "wb");
+	if (! f)
+	{
+	    perror(name);
+	    exit(1);
+	}
+	fprintf(f, "P6\n%d %d\n255\n", cols * PPM_SCALE, rows * PPM_SCALE);
+	for (int py = 0; py < rows * PPM_SCALE; py++)
+	    for (int px = 0; px < cols * PPM_SCALE; px++)
+		fwrite(rgb[py / PPM_SCALE][px / PPM_SCALE], 3, 1, f);
+	fclose(f);
+    }
+    else
+    {
+	printf("\x1b[H");
+	for (uint8_t y = 0; y < rows; y++)
+	{
+	    for (uint8_t x = 0; x < cols; x++)
+		printf("\x1b[38;2;%d;%d;%dm██", rgb[y][x][0],
+		    rgb[y][x][1], rgb[y][x][2]);
+	    printf("\x1b[0m\n");
+	}
+	printf("t=%.2fs refresh %.1fHz ISR load %d%%\x1b[K\n",
+	    (double) host_cycles / HOST_F_CPU,
+	    DirectMatrix_FRAME_TIME ? 1e6 / DirectMatrix_FRAME_TIME : 0.0,
+	    DirectMatrix_FRAME_TIME ?
+		(int) (DirectMatrix_FRAME_BUSY * 100 / DirectMatrix_FRAME_TIME) : 0);
+	fflush(stdout);
+    }
+    frames++;
+}
+
+static void tick(void) {
+    static uint64_t started;
+    static struct timespec start;
+    struct timespec now;
+
+    render();
+    if (host_cycles >= end_cycle)
+    {
+	fprintf(stderr, "%u frames rendered over %.2fs simulated\n", frames,
+	    (double) host_cycles / HOST_F_CPU);
+	exit(0);
+    }
+
+    if (! realtime || ppm_prefix) return;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    if (! started)
+    {
+	started = host_cycles;
+	start = now;
+	return;
+    }
+    double sim = (double) (host_cycles - started) / HOST_F_CPU;
+    double real = (now.tv_sec - start.tv_sec) +
+		  (now.tv_nsec - start.tv_nsec) / 1e9;
+    if (sim > real) usleep((sim - real) * 1e6);
+}
+
+int main(int argc, char **argv) {
+    double seconds = 10;
+    uint32_t fps = 25;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "t:f:o:n")) != -1)
+    {
+	switch (opt)
+	{
+	case 't':
+	    seconds = atof(optarg);
+	    break;
+	case 'f':
+	    fps = atoi(optarg);
+	    break;
+	case 'o':
+	    ppm_prefix = optarg;
+	    break;
+	case 'n':
+	    realtime = 0;
+	    break;
+	default:
+	    fprintf(stderr, "usage: %s [-t seconds] [-f fps] [-o ppm_prefix] "
+		"[-n]\n", argv[0]);
+	    return 1;
+	}
+    }
+    if (! fps) fps = 25;
+
+    host_serial_fd(2);
+    host_add_pin_listener(pin_changed);
+    end_cycle = seconds * HOST_F_CPU;
+    host_every(HOST_F_CPU / fps, tick);
+    if (! ppm_prefix) printf("\x1b[2J");
+
+    setup();
+    for (;;)
+    {
+	loop();
+	// the Arduino main() loop and an empty loop() still take time
+	host_advance(8);
+    }
+}
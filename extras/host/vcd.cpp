@@ -0,0 +1,110 @@
+/*
+ * vcd.cpp
+ *
+ * VCD writer, see vcd.h.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "Arduino.h"
+#include "vcd.h"
+
+#define VCD_MAX_SIGNALS 64
+
+// 1 cycle at 16MHz is 62.5ns = 625 * 100ps
+#define VCD_UNITS_PER_CYCLE (10000000000ULL / HOST_F_CPU)
+
+static FILE *vcd;
+static uint8_t started;
+static uint64_t last_time = ~0ULL;
+
+static struct {
+    uint16_t pin;
+    char name[32];
+    char scope[16];
+    char id[3];
+} signals[VCD_MAX_SIGNALS];
+static uint8_t num_signals;
+
+static void vcd_time(uint64_t cycle) {
+    if (cycle == last_time) return;
+    last_time = cycle;
+    fprintf(vcd, "#%llu\n", (unsigned long long) (cycle * VCD_UNITS_PER_CYCLE));
+}
+
+static void vcd_change(uint16_t pin, uint8_t value, uint64_t cycle) {
+    if (! started) return;
+    for (uint8_t i = 0; i < num_signals; i++)
+    {
+	if (signals[i].pin != pin) continue;
+	vcd_time(cycle);
+	fprintf(vcd, "%d%s\n", value ? 1 : 0, signals[i].id);
+    }
+}
+
+int vcd_open(const char *filename) {
+    vcd = fopen(filename, "w");
+    if (! vcd) return -1;
+    host_add_pin_listener(vcd_change);
+    return 0;
+}
+
+void vcd_pin(uint16_t pin, const char *name, const char *scope) {
+    if (num_signals >= VCD_MAX_SIGNALS || ! GPIO_PIN_MASK(pin)) return;
+    signals[num_signals].pin = pin;
+    snprintf(signals[num_signals].name, sizeof(signals[0].name), "%s_%s",
+	name, host_pin_name(pin));
+    snprintf(signals[num_signals].scope, sizeof(signals[0].scope), "%s",
+	scope);
+    // identifiers are printable ASCII characters
+    signals[num_signals].id[0] = '!' + num_signals % 90;
+    signals[num_signals].id[1] = num_signals >= 90 ? '!' + num_signals / 90 : 0;
+    num_signals++;
+}
+
+void vcd_start(void) {
+    const char *scope = "";
+
+    if (! vcd) return;
+    fprintf(vcd, "$date simulated $end\n");
+    fprintf(vcd, "$version LED-Matrix host simulator $end\n");
+    fprintf(vcd, "$timescale 100ps $end\n");
+    fprintf(vcd, "$scope module matrix $end\n");
+    for (uint8_t i = 0; i < num_signals; i++)
+    {
+	if (strcmp(scope, signals[i].scope))
+	{
+	    if (*scope) fprintf(vcd, "$upscope $end\n");
+	    scope = signals[i].scope;
+	    fprintf(vcd, "$scope module %s $end\n", scope);
+	}
+	fprintf(vcd, "$var wire 1 %s %s $end\n", signals[i].id, signals[i].name);
+    }
+    if (*scope) fprintf(vcd, "$upscope $end\n");
+    fprintf(vcd, "$upscope $end\n$enddefinitions $end\n");
+
+    vcd_time(host_cycles);
+    fprintf(vcd, "$dumpvars\n");
+    for (uint8_t i = 0; i < num_signals; i++)
+    {
+	uint16_t pin = signals[i].pin;
+	fprintf(vcd, "%d%s\n", 
+	    (host_port(pin & 0xFF) & GPIO_PIN_MASK(pin)) ? 1 : 0, signals[i].id);
+    }
+    fprintf(vcd, "$end\n");
+    started = 1;
+}
+
+void vcd_comment(const char *text) {
+    if (! started) return;
+    vcd_time(host_cycles);
+    fprintf(vcd, "$comment %s $end\n", text);
+}
+
+void vcd_close(void) {
+    if (! vcd) return;
+    vcd_time(host_cycles);
+    fclose(vcd);
+    vcd = NULL;
+    started = 0;
+}
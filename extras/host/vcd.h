@@ -0,0 +1,24 @@
+/*
+ * vcd.h
+ *
+ * Value Change Dump (IEEE 1364) writer for the simulated pins, to look at
+ * the scan the way a logic analyzer would (GTKWave, PulseView...).
+ * Declare the signals with vcd_pin() before vcd_start(), every change of a
+ * declared pin is then written with its cycle timestamp (62.5ns at 16MHz).
+ */
+
+#ifndef VCD_H_
+#define VCD_H_
+
+#include <stdint.h>
+
+int vcd_open(const char *filename);
+// Name a pin (e.g. "row0", "clk") and optionally put it in a group
+void vcd_pin(uint16_t pin, const char *name, const char *scope = "pins");
+// Write the header and initial values, then record changes
+void vcd_start(void);
+// Add a marker/comment at the current time (e.g. "frame")
+void vcd_comment(const char *text);
+void vcd_close(void);
+
+#endif /* VCD_H_ */
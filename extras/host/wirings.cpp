@@ -0,0 +1,48 @@
+/*
+ * wirings.cpp
+ *
+ * The wirings used by the examples, for the host tools.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "LED_Matrix.h"
+#include "wirings.h"
+
+host_wiring host_wirings[] = {
+    // examples/directmatrix8x8: red, direct
+    { "mono", 1, 0, 200,
+      { DP5, DP6, DP7, DP8, DP12, DP11, DP10, DP9 },
+      { DP0,  DP4, DP19, DP18, DP17, DP16, DP15, DP14,
+	DINV, DINV, DINV, DINV, DINV, DINV, DINV, DINV,
+	DINV, DINV, DINV, DINV, DINV, DINV, DINV, DINV, },
+      { DINV, DINV, DINV, DINV, DINV } },
+    // examples/directmatrix8x8_bicolor_direct_sr: red direct, green by SR
+    { "bicolor", 2, 0, 200,
+      { DP5, DP6, DP7, DP8, DP12, DP11, DP10, DP9 },
+      { DP0,  DP4, DP19, DP18, DP17, DP16, DP15, DP14,
+	DINV, DINV, DINV, DINV, DINV, DINV, DINV, DINV,
+	DINV, DINV, DINV, DINV, DINV, DINV, DINV, DINV, },
+      { DINV, DP13, DINV, DP3, DP2 } },
+    // examples/directmatrix8x8_tricolor_direct_sr: red and blue by reversed
+    // SR, green direct, common anode
+    { "tricolor", 3, 1, 180,
+      { DP17, DP16, DP15, DP14,  DP9, DP10, DP11, DP12 },
+      { DINV, DINV, DINV, DINV, DINV, DINV, DINV, DINV, 
+	DP8,  DP7,  DP6,  DP5,  DP4,  DP3,  DP2,  DP1,
+	DINV, DINV, DINV, DINV, DINV, DINV, DINV, DINV, },
+      { (GPIO_pin_t) -DP18, DINV, (GPIO_pin_t) -DP0, DP13, DP19 } },
+    { NULL },
+};
+
+host_wiring *host_find_wiring(const char *name) {
+    for (host_wiring *w = host_wirings; w->name; w++)
+	if (! strcmp(w->name, name)) return w;
+    return NULL;
+}
+
+void host_list_wirings(void) {
+    for (host_wiring *w = host_wirings; w->name; w++)
+	fprintf(stderr, " %s", w->name);
+    fprintf(stderr, "\n");
+}
@@ -0,0 +1,29 @@
+/*
+ * wirings.h
+ *
+ * The wirings used by the examples, for the host tools.
+ */
+
+#ifndef WIRINGS_H_
+#define WIRINGS_H_
+
+#include "Arduino.h"
+
+struct host_wiring {
+    const char *name;
+    uint8_t colors;
+    uint8_t common;	// 0 for common cathode rows
+    uint32_t isr_freq;
+    GPIO_pin_t rows[8];
+    GPIO_pin_t cols[24];
+    GPIO_pin_t sr[5];
+};
+
+extern host_wiring host_wirings[];
+
+// Look up a wiring by name, NULL if unknown
+host_wiring *host_find_wiring(const char *name);
+// Print the known names to stderr
+void host_list_wirings(void);
+
+#endif /* WIRINGS_H_ */
@@ -0,0 +1,169 @@
+/*
+ * Arduino.h
+ *
+ * Linux stand-in for the Arduino core, see linux_gpio.h. Only what the
+ * library and its examples use is provided, like extras/host/Arduino.h,
+ * but on real GPIO lines and real time.
+ * It also provides the arduino2.h fast I/O API on top of the GPIO banks
+ * and defines ARDUINO2_H_ so that the AVR only arduino2.h of the library
+ * is skipped.
+ */
+
+#ifndef Arduino_h
+#define Arduino_h
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <math.h>
+
+#include "linux_gpio.h"
+
+#ifndef ARDUINO
+#define ARDUINO 10600
+#endif
+
+#define HIGH 0x1
+#define LOW  0x0
+
+#define INPUT 0x0
+#define OUTPUT 0x1
+#define INPUT_PULLUP 0x2
+
+#define DEC 10
+#define HEX 16
+#define BIN 2
+
+#define A0 14
+#define A1 15
+#define A2 16
+#define A3 17
+#define A4 18
+#define A5 19
+
+#define PROGMEM
+#define PSTR(s) (s)
+#define pgm_read_byte(addr) (*(const uint8_t *)(addr))
+#define pgm_read_word(addr) (*(const uint16_t *)(addr))
+#define pgm_read_dword(addr) (*(const uint32_t *)(addr))
+#define pgm_read_ptr(addr) (*(void * const *)(addr))
+#define memcpy_P memcpy
+#define strlen_P strlen
+
+#define PI 3.1415926535897932384626433832795
+#define min(a,b) ((a)<(b)?(a):(b))
+#define max(a,b) ((a)>(b)?(a):(b))
+#define abs(x) ((x)>0?(x):-(x))
+#define constrain(amt,low,high) ((amt)<(low)?(low):((amt)>(high)?(high):(amt)))
+
+typedef bool boolean;
+typedef uint8_t byte;
+
+void pinMode(uint8_t, uint8_t);
+void digitalWrite(uint8_t, uint8_t);
+int digitalRead(uint8_t);
+unsigned long millis(void);
+unsigned long micros(void);
+void delay(unsigned long);
+void delayMicroseconds(unsigned int us);
+long random(long);
+long random(long, long);
+void randomSeed(unsigned long);
+
+// The refresh "interrupt" is a thread, these hold it off
+void noInterrupts(void);
+void interrupts(void);
+#define cli() noInterrupts()
+#define sei() interrupts()
+void yield(void);
+
+#include "Print.h"
+
+class HardwareSerial : public Print {
+ public:
+  void begin(unsigned long) { }
+  operator bool() { return true; }
+  int available(void) { return 0; }
+  int read(void) { return -1; }
+  size_t write(uint8_t);
+  using Print::write;
+};
+extern HardwareSerial Serial;
+
+// ===========================================================================
+// arduino2.h API on the GPIO banks
+// ===========================================================================
+#define ARDUINO2_H_
+#define GPIO2_PREFER_SPEED 1
+
+#define GPIO_MAKE_PINCODE(port, pin)  (((uint16_t)port & 0x00FF) | ((1<<pin) << 8))
+#define GPIO_PIN_MASK(pin) ((uint8_t)((uint16_t)pin >> 8))
+
+// A plain integer rather than an enum so that the negative pin trick used
+// for reversed shift registers works the same as on AVR.
+typedef uint16_t GPIO_pin_t;
+
+enum {
+  DP_INVALID = 0x0025,
+  DP0 = GPIO_MAKE_PINCODE(LINUX_PORTD,0),
+  DP1 = GPIO_MAKE_PINCODE(LINUX_PORTD,1),
+  DP2 = GPIO_MAKE_PINCODE(LINUX_PORTD,2),
+  DP3 = GPIO_MAKE_PINCODE(LINUX_PORTD,3),
+  DP4 = GPIO_MAKE_PINCODE(LINUX_PORTD,4),
+  DP5 = GPIO_MAKE_PINCODE(LINUX_PORTD,5),
+  DP6 = GPIO_MAKE_PINCODE(LINUX_PORTD,6),
+  DP7 = GPIO_MAKE_PINCODE(LINUX_PORTD,7),
+  DP8 = GPIO_MAKE_PINCODE(LINUX_PORTB,0),
+  DP9 = GPIO_MAKE_PINCODE(LINUX_PORTB,1),
+  DP10 = GPIO_MAKE_PINCODE(LINUX_PORTB,2),
+  DP11 = GPIO_MAKE_PINCODE(LINUX_PORTB,3),
+  DP12 = GPIO_MAKE_PINCODE(LINUX_PORTB,4),
+  DP13 = GPIO_MAKE_PINCODE(LINUX_PORTB,5),
+  DP14 = GPIO_MAKE_PINCODE(LINUX_PORTC,0),
+  DP15 = GPIO_MAKE_PINCODE(LINUX_PORTC,1),
+  DP16 = GPIO_MAKE_PINCODE(LINUX_PORTC,2),
+  DP17 = GPIO_MAKE_PINCODE(LINUX_PORTC,3),
+  DP18 = GPIO_MAKE_PINCODE(LINUX_PORTC,4),
+  DP19 = GPIO_MAKE_PINCODE(LINUX_PORTC,5),
+};
+
+#define GPIO_PINS_NUMBER 20
+
+void pinMode2f(GPIO_pin_t pin, uint8_t mode);
+void digitalWrite2f(GPIO_pin_t pin, uint8_t value);
+uint8_t digitalRead2f(GPIO_pin_t pin);
+GPIO_pin_t Arduino_to_GPIO_pin(uint8_t pin);
+// Same as arduino2.h, as a constant expression
+constexpr GPIO_pin_t GPIO_PIN(uint8_t pin) {
+  return pin < 8 ? GPIO_MAKE_PINCODE(LINUX_PORTD, pin) :
+	 pin < 14 ? GPIO_MAKE_PINCODE(LINUX_PORTB, (pin - 8)) :
+	 pin < GPIO_PINS_NUMBER ? GPIO_MAKE_PINCODE(LINUX_PORTC, (pin - 14)) :
+	 DP_INVALID;
+}
+// Register access by pin code, like pins2_arduino.h: a whole bank of
+// lines is written with one ioctl.
+class linux_reg {
+ public:
+  linux_reg(uint16_t pin, uint8_t ddr) : addr(pin & 0xFF), ddr(ddr) { }
+  operator uint8_t() const { return linux_reg_read(addr, ddr); }
+  linux_reg &operator=(uint8_t value) {
+    linux_reg_write(addr, ddr, value);
+    return *this;
+  }
+  linux_reg &operator|=(uint8_t value) { return *this = *this | value; }
+  linux_reg &operator&=(uint8_t value) { return *this = *this & value; }
+ private:
+  uint8_t addr;
+  uint8_t ddr;
+};
+#define GPIO_PORT_REG(pin) linux_reg(pin, 0)
+#define GPIO_DDR_REG(pin) linux_reg(pin, 1)
+
+#define pinMode2(pin, mode) pinMode2f(Arduino_to_GPIO_pin(pin), mode)
+#define digitalWrite2(pin, value) digitalWrite2f(Arduino_to_GPIO_pin(pin), value)
+#define digitalRead2(pin) digitalRead2f(Arduino_to_GPIO_pin(pin))
+
+#include "binary.h"
+
+#endif /* Arduino_h */
@@ -0,0 +1,44 @@
+/*
+ * TimerOne.h
+ *
+ * Linux stand-in for https://www.pjrc.com/teensy/td_libs_TimerOne.html: the
+ * "interrupt" runs on a realtime thread, see linux_gpio.h.
+ */
+
+#ifndef TimerOne_h_
+#define TimerOne_h_
+
+#include "linux_gpio.h"
+
+class TimerOne {
+ public:
+  void initialize(unsigned long microseconds = 1000000) {
+    period = microseconds;
+    linux_timer1_set(period, isr);
+  }
+  void setPeriod(unsigned long microseconds) {
+    period = microseconds;
+    linux_timer1_period(period);
+  }
+  void start(void) { linux_timer1_restart(); }
+  void stop(void) { linux_timer1_stop(); }
+  void restart(void) { linux_timer1_restart(); }
+  void resume(void) { linux_timer1_resume(); }
+  void attachInterrupt(void (*f)(void), long microseconds = -1) {
+    if (microseconds > 0) period = microseconds;
+    isr = f;
+    linux_timer1_set(period, isr);
+  }
+  void detachInterrupt(void) {
+    isr = 0;
+    linux_timer1_set(period, isr);
+  }
+
+ private:
+  unsigned long period;
+  void (*isr)(void);
+};
+
+extern TimerOne Timer1;
+
+#endif /* TimerOne_h_ */
@@ -0,0 +1,122 @@
+/*
+ * bench_gpio.cpp
+ *
+ * Runs the DirectMatrix scan for one of the example wirings on the GPIO
+ * lines and reports, for each write strategy (see linux_gpio.h), the row
+ * rate the refresh thread sustains and how late it wakes up.
+ *
+ * Usage: bench_gpio [-w wiring] [-t seconds] [-s line|bank] [-f isr_freq]
+ * - wiring: one of the example wirings (mono, bicolor, tricolor)
+ * - seconds: measuring time per strategy, default 5
+ * - strategy: only run this one, default both
+ * - isr_freq: as in begin(), default that of the wiring. Raise it until
+ *   the thread can't keep up to find the limit of the chip.
+ *
+ * Build with make SCAN=1 to compare with the scan program.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "LED_Matrix.h"
+#include "wirings.h"
+
+static void usage(void) {
+    fprintf(stderr, "usage: bench_gpio [-w wiring] [-t seconds] "
+	"[-s line|bank] [-f isr_freq]\nwirings:");
+    host_list_wirings();
+    exit(1);
+}
+
+// Deadline latency percentile from the histogram, in us
+static uint32_t percentile(const linux_stats_t *s, uint32_t permille) {
+    uint64_t want = (uint64_t) s->isr_runs * permille / 1000;
+    uint64_t seen = 0;
+
+    for (uint32_t i = 0; i < LINUX_LATENCY_BINS; i++)
+    {
+	seen += s->latency[i];
+	if (seen > want) return i;
+    }
+    return LINUX_LATENCY_BINS - 1;
+}
+
+static void measure(PWMDirectMatrix *matrix, uint8_t strategy,
+		    uint32_t seconds) {
+    static linux_stats_t s;
+    uint32_t runs;
+
+    linux_gpio_batch(strategy);
+    // Let the library settle its quality level first
+    delay(500);
+    linux_stats(&s, 1);
+    delay(seconds * 1000);
+    linux_stats(&s, 1);
+
+    runs = s.isr_runs ? s.isr_runs : 1;
+    printf("%-8s %7lu %7lu %6.1f %7.1f %7.1f %7u %7u %7u %7lu %4u%% %2u\n",
+	strategy == LINUX_GPIO_LINE ? "line" : "bank",
+	(unsigned long) (8000000ULL / max(matrix->frameTime(), 1UL)),
+	(unsigned long) (s.isr_runs / seconds),
+	(double) s.ioctls / runs,
+	s.isr_sum / 1000.0 / runs, s.isr_max / 1000.0,
+	(unsigned) (s.latency_sum / 1000 / runs), percentile(&s, 990),
+	s.latency_max / 1000, (unsigned long) s.missed / seconds,
+	matrix->cpuLoad(), matrix->quality());
+}
+
+int main(int argc, char **argv) {
+    host_wiring *w = host_find_wiring("bicolor");
+    uint32_t seconds = 5;
+    uint32_t freq = 0;
+    int strategy = -1;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "w:t:s:f:")) != -1)
+    {
+	switch (opt)
+	{
+	case 'w':
+	    if (! (w = host_find_wiring(optarg))) usage();
+	    break;
+	case 't':
+	    seconds = max(atoi(optarg), 1);
+	    break;
+	case 's':
+	    if (! strcmp(optarg, "line")) strategy = LINUX_GPIO_LINE;
+	    else if (! strcmp(optarg, "bank")) strategy = LINUX_GPIO_BANK;
+	    else usage();
+	    break;
+	case 'f':
+	    freq = atoi(optarg);
+	    break;
+	default:
+	    usage();
+	}
+    }
+
+    PWMDirectMatrix *matrix = new PWMDirectMatrix(8, 8, w->colors, w->common);
+    matrix->clear();
+    for (uint8_t y = 0; y < 8; y++)
+	for (uint8_t x = 0; x < 8; x++)
+	{
+	    uint16_t level = (y * 8 + x) / 4;
+	    matrix->drawPixel(x, y, level | level << 4 | level << 8);
+	}
+    matrix->begin(w->rows, w->cols, w->sr, freq ? freq : w->isr_freq);
+    matrix->writeDisplay();
+
+    linux_stats_t s;
+    linux_stats(&s, 0);
+    printf("%s wiring, %us per strategy, %s refresh thread\n", w->name,
+	seconds, s.realtime ? "SCHED_FIFO" : "SCHED_OTHER");
+    printf("strategy  rows/s   ISR/s ioctl/     ISR     ISR    late    late"
+	"    late  lost/s load q\n"
+	"                           ISR mean us  max us mean us  p99 us"
+	"  max us\n");
+    if (strategy != LINUX_GPIO_BANK) measure(matrix, LINUX_GPIO_LINE, seconds);
+    if (strategy != LINUX_GPIO_LINE) measure(matrix, LINUX_GPIO_BANK, seconds);
+    linux_gpio_release();
+    return 0;
+}
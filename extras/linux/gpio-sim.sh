@@ -0,0 +1,20 @@
+#!/bin/sh
+# Create (or remove with -r) a gpio-sim chip with the 20 lines of an Uno
+# to run the Linux builds without hardware. Needs root, configfs and the
+# gpio-sim module (CONFIG_GPIO_SIM, Linux 5.17+). Prints the device to use
+# as LEDMATRIX_GPIOCHIP.
+
+SIM=/sys/kernel/config/gpio-sim/ledmatrix
+
+if [ "$1" = "-r" ]; then
+    echo 0 > $SIM/live
+    rmdir $SIM/bank0 $SIM
+    exit 0
+fi
+
+modprobe gpio-sim || exit 1
+mountpoint -q /sys/kernel/config || mount -t configfs none /sys/kernel/config
+mkdir -p $SIM/bank0 || exit 1
+echo 20 > $SIM/bank0/num_lines
+echo 1 > $SIM/live
+echo /dev/$(cat $SIM/bank0/chip_name)
@@ -0,0 +1,629 @@
+/*
+ * linux.cpp
+ *
+ * Arduino core on a Linux GPIO character device, see linux_gpio.h.
+ */
+
+#include <stdio.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/prctl.h>
+#include <linux/gpio.h>
+#include "Arduino.h"
+#include "TimerOne.h"
+
+HardwareSerial Serial;
+TimerOne Timer1;
+
+// One line request per Uno port
+struct bank {
+    uint8_t addr;	// LINUX_PORTx
+    uint8_t first;	// Arduino pin of bit 0
+    uint8_t valid;	// bits that are pins
+    uint8_t used;	// bits with a line in the request
+    int fd;
+    uint8_t out;	// PORTx
+    uint8_t ddr;	// DDRx
+    uint8_t pending;	// changed bits not written yet (bank strategy)
+    uint8_t strobe;	// bits always written alone (bank strategy)
+};
+
+static bank banks[3] = {
+    { LINUX_PORTD, 0, 0xFF, 0, -1 },
+    { LINUX_PORTB, 8, 0x3F, 0, -1 },
+    { LINUX_PORTC, 14, 0x3F, 0, -1 },
+};
+
+static const GPIO_pin_t arduino_pins[GPIO_PINS_NUMBER] = {
+    DP0, DP1, DP2, DP3, DP4, DP5, DP6, DP7, DP8, DP9,
+    DP10, DP11, DP12, DP13, DP14, DP15, DP16, DP17, DP18, DP19,
+};
+
+static int chip_fd = -1;
+static uint32_t lines[GPIO_PINS_NUMBER];
+static uint8_t batch = LINUX_GPIO_BANK;
+static bank *pending_bank;
+static uint8_t released;
+
+static pthread_mutex_t irq_lock;
+static __thread uint8_t irq_off;	// this thread holds irq_lock
+static __thread uint8_t in_isr;
+
+static pthread_mutex_t timer_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t timer_cond;
+
+static struct {
+    void (*isr)(void);
+    uint64_t period;	// in ns
+    uint64_t last;	// when the last interrupt was due
+    uint64_t next;	// when the next one is due
+    uint64_t left;	// ns left to next when stopped
+    uint8_t running;
+    uint8_t thread;	// the thread is started
+} timer1;
+
+static linux_stats_t stats;
+static uint64_t start_ns;
+
+static inline uint64_t now_ns(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void fail(const char *what) {
+    fprintf(stderr, "LED-Matrix linux: %s: %s\n", what, strerror(errno));
+    exit(1);
+}
+
+__attribute__((constructor))
+static void linux_init(void) {
+    pthread_mutexattr_t mattr;
+    pthread_condattr_t cattr;
+    const char *env;
+
+    start_ns = now_ns();
+    // The refresh thread must not wait behind a low priority thread that
+    // got preempted in noInterrupts()
+    pthread_mutexattr_init(&mattr);
+    pthread_mutexattr_setprotocol(&mattr, PTHREAD_PRIO_INHERIT);
+    pthread_mutex_init(&irq_lock, &mattr);
+    pthread_condattr_init(&cattr);
+    pthread_condattr_setclock(&cattr, CLOCK_MONOTONIC);
+    pthread_cond_init(&timer_cond, &cattr);
+
+    for (uint8_t i = 0; i < GPIO_PINS_NUMBER; i++) lines[i] = i;
+    if ((env = getenv("LEDMATRIX_GPIO_LINES")))
+    {
+	for (uint8_t i = 0; i < GPIO_PINS_NUMBER && *env; i++)
+	{
+	    char *end;
+	    lines[i] = strtoul(env, &end, 0);
+	    env = (*end == ',') ? end + 1 : end;
+	}
+    }
+    if ((env = getenv("LEDMATRIX_GPIO_BATCH")))
+	batch = strcmp(env, "line") ? LINUX_GPIO_BANK : LINUX_GPIO_LINE;
+}
+
+// ===========================================================================
+// GPIO
+// ===========================================================================
+static inline bank *bank_of(uint16_t pin) {
+    switch (pin & 0xFF)
+    {
+    case LINUX_PORTD: return &banks[0];
+    case LINUX_PORTB: return &banks[1];
+    default: return &banks[2];
+    }
+}
+
+// Bank bits to line request bits: the request has the used lines in bit
+// order
+static uint64_t request_bits(const bank *b, uint8_t bits) {
+    uint64_t r = 0;
+    uint8_t i = 0;
+
+    for (uint8_t bit = 0; bit < 8; bit++)
+    {
+	if (! (b->used & (1 << bit))) continue;
+	if (bits & (1 << bit)) r |= (uint64_t) 1 << i;
+	i++;
+    }
+    return r;
+}
+
+static void bank_config(const bank *b, gpio_v2_line_config *config) {
+    uint64_t outputs = request_bits(b, b->ddr);
+    uint64_t pullups = request_bits(b, ~b->ddr & b->out);
+    uint8_t n = 0;
+
+    memset(config, 0, sizeof(*config));
+    config->flags = GPIO_V2_LINE_FLAG_INPUT;
+    if (outputs)
+    {
+	config->attrs[n].attr.id = GPIO_V2_LINE_ATTR_ID_FLAGS;
+	config->attrs[n].attr.flags = GPIO_V2_LINE_FLAG_OUTPUT;
+	config->attrs[n++].mask = outputs;
+	config->attrs[n].attr.id = GPIO_V2_LINE_ATTR_ID_OUTPUT_VALUES;
+	config->attrs[n].attr.values = request_bits(b, b->out);
+	config->attrs[n++].mask = outputs;
+    }
+    if (pullups)
+    {
+	config->attrs[n].attr.id = GPIO_V2_LINE_ATTR_ID_FLAGS;
+	config->attrs[n].attr.flags = GPIO_V2_LINE_FLAG_INPUT |
+	    GPIO_V2_LINE_FLAG_BIAS_PULL_UP;
+	config->attrs[n++].mask = pullups;
+    }
+    config->num_attrs = n;
+}
+
+// Line requests can't grow: a new pin means a new request
+static void bank_request(bank *b) {
+    gpio_v2_line_request req;
+    uint8_t n = 0;
+
+    if (chip_fd < 0)
+    {
+	const char *chip = getenv("LEDMATRIX_GPIOCHIP");
+
+	if (! chip) chip = "/dev/gpiochip0";
+	if ((chip_fd = open(chip, O_RDWR | O_CLOEXEC)) < 0) fail(chip);
+	atexit(linux_gpio_release);
+    }
+    if (b->fd >= 0) close(b->fd);
+    memset(&req, 0, sizeof(req));
+    for (uint8_t bit = 0; bit < 8; bit++)
+	if (b->used & (1 << bit)) req.offsets[n++] = lines[b->first + bit];
+    req.num_lines = n;
+    strcpy(req.consumer, "LED-Matrix");
+    bank_config(b, &req.config);
+    if (ioctl(chip_fd, GPIO_V2_GET_LINE_IOCTL, &req) < 0)
+	fail("GPIO_V2_GET_LINE_IOCTL");
+    b->fd = req.fd;
+}
+
+static void bank_reconfig(bank *b) {
+    gpio_v2_line_config config;
+
+    if (released || ! b->used) return;
+    bank_config(b, &config);
+    if (ioctl(b->fd, GPIO_V2_LINE_SET_CONFIG_IOCTL, &config) < 0)
+	fail("GPIO_V2_LINE_SET_CONFIG_IOCTL");
+}
+
+static void bank_write(bank *b, uint8_t changed) {
+    gpio_v2_line_values values;
+
+    if (released) return;
+    values.bits = request_bits(b, b->out);
+    values.mask = request_bits(b, changed);
+    ioctl(b->fd, GPIO_V2_LINE_SET_VALUES_IOCTL, &values);
+    __atomic_fetch_add(&stats.ioctls, 1, __ATOMIC_RELAXED);
+}
+
+void linux_gpio_flush(void) {
+    bank *b = pending_bank;
+
+    if (! b) return;
+    pending_bank = NULL;
+    bank_write(b, b->pending);
+    b->pending = 0;
+}
+
+void linux_gpio_batch(uint8_t strategy) {
+    batch = strategy;
+}
+
+// Directions or pins changed, pins gets a line in the request
+static void bank_setup(bank *b, uint8_t ddr, uint8_t out, uint8_t pins) {
+    uint8_t used = b->used | ((ddr | pins) & b->valid);
+
+    linux_gpio_flush();
+    b->ddr = ddr & b->valid;
+    b->out = out;
+    if (used != b->used)
+    {
+	b->used = used;
+	bank_request(b);
+    }
+    else bank_reconfig(b);
+}
+
+static void bank_set(bank *b, uint8_t out) {
+    uint8_t changed = (b->out ^ out) & b->ddr & b->used;
+
+    // Pull-ups of inputs, like writing PORTx on AVR
+    if ((b->out ^ out) & ~b->ddr & b->used)
+    {
+	bank_setup(b, b->ddr, out, 0);
+	return;
+    }
+    if (! changed)
+    {
+	b->out = out;
+	return;
+    }
+    if (! in_isr || batch == LINUX_GPIO_LINE)
+    {
+	b->out = out;
+	bank_write(b, changed);
+	return;
+    }
+    // A line of the batch changing again is a strobe: its first edge must
+    // not come with the data it clocks.
+    b->strobe |= changed & b->pending;
+    if (pending_bank != b || (changed & b->strobe)) linux_gpio_flush();
+    b->out = out;
+    b->pending |= changed;
+    pending_bank = b;
+    if (changed & b->strobe) linux_gpio_flush();
+}
+
+// Back to inputs at exit, a row left on would get the DC current
+void linux_gpio_release(void) {
+    uint8_t locked = irq_off;
+
+    if (released) return;
+    if (! locked) pthread_mutex_lock(&irq_lock);
+    linux_timer1_stop();
+    pending_bank = NULL;
+    for (uint8_t i = 0; i < 3; i++)
+    {
+	bank *b = &banks[i];
+	if (b->fd < 0) continue;
+	b->ddr = b->out = 0;
+	bank_reconfig(b);
+	close(b->fd);
+    }
+    released = 1;
+    if (! locked) pthread_mutex_unlock(&irq_lock);
+}
+
+uint8_t linux_reg_read(uint8_t addr, uint8_t ddr) {
+    bank *b = bank_of(addr);
+
+    return ddr ? b->ddr : b->out;
+}
+
+void linux_reg_write(uint8_t addr, uint8_t ddr, uint8_t value) {
+    bank *b = bank_of(addr);
+
+    if (ddr) bank_setup(b, value, b->out, 0);
+    else bank_set(b, value);
+}
+
+// ===========================================================================
+// Timer1
+// ===========================================================================
+static void *timer_thread(void *) {
+    const char *env;
+
+    // Wake up on time, not up to 50us late like normal threads
+    prctl(PR_SET_TIMERSLACK, 1);
+    if ((env = getenv("LEDMATRIX_CPU")))
+    {
+	cpu_set_t cpus;
+	CPU_ZERO(&cpus);
+	CPU_SET(atoi(env), &cpus);
+	pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+    }
+    pthread_mutex_lock(&timer_lock);
+    for (;;)
+    {
+	if (! timer1.running || ! timer1.isr)
+	{
+	    pthread_cond_wait(&timer_cond, &timer_lock);
+	    continue;
+	}
+	if (now_ns() < timer1.next)
+	{
+	    struct timespec ts;
+	    ts.tv_sec = timer1.next / 1000000000;
+	    ts.tv_nsec = timer1.next % 1000000000;
+	    pthread_cond_timedwait(&timer_cond, &timer_lock, &ts);
+	    continue;
+	}
+	void (*isr)(void) = timer1.isr;
+	uint64_t due = timer1.next;
+	timer1.last = due;
+	timer1.next = due + timer1.period;
+	pthread_mutex_unlock(&timer_lock);
+
+	pthread_mutex_lock(&irq_lock);
+	uint64_t start = now_ns();
+	in_isr = irq_off = 1;
+	isr();
+	linux_gpio_flush();
+	in_isr = irq_off = 0;
+	pthread_mutex_unlock(&irq_lock);
+	uint64_t end = now_ns();
+
+	pthread_mutex_lock(&timer_lock);
+	uint32_t latency = start - due;
+	uint32_t runtime = end - start;
+	stats.isr_runs++;
+	stats.latency_sum += latency;
+	if (latency > stats.latency_max) stats.latency_max = latency;
+	stats.latency[min(latency / 1000, LINUX_LATENCY_BINS - 1)]++;
+	stats.isr_sum += runtime;
+	if (runtime > stats.isr_max) stats.isr_max = runtime;
+	// Like the AVR overflow flag, overflows missed while in the ISR
+	// collapse into a single pending interrupt.
+	while (timer1.next + timer1.period <= end)
+	{
+	    timer1.next += timer1.period;
+	    stats.missed++;
+	}
+    }
+    return NULL;
+}
+
+static void timer1_thread(void) {
+    pthread_attr_t attr;
+    pthread_t thread;
+    const char *env = getenv("LEDMATRIX_RT_PRIO");
+    int prio = env ? atoi(env) : 80;
+
+    timer1.thread = 1;
+    // Page faults in the ISR would be worse than any scheduling latency
+    mlockall(MCL_CURRENT | MCL_FUTURE);
+    pthread_attr_init(&attr);
+    if (prio > 0)
+    {
+	struct sched_param param;
+	param.sched_priority = prio;
+	pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED);
+	pthread_attr_setschedpolicy(&attr, SCHED_FIFO);
+	pthread_attr_setschedparam(&attr, &param);
+	if (! pthread_create(&thread, &attr, timer_thread, NULL))
+	{
+	    stats.realtime = 1;
+	    return;
+	}
+	fprintf(stderr, "LED-Matrix linux: no SCHED_FIFO (needs "
+	    "CAP_SYS_NICE or an rtprio limit), refresh will jitter\n");
+    }
+    if (pthread_create(&thread, NULL, timer_thread, NULL))
+	fail("pthread_create");
+}
+
+// The shift register clock and latches given to begin() (and the HUB75
+// CLK and LAT), from LED_Matrix.cpp. LED_Matrix.h can't be included here,
+// its pinMode/digitalWrite macros would rename ours: the indices are those
+// of LATCH1..LATCH3, CLK and HUB75_CLK, HUB75_LAT.
+#define SR_LATCHES 3
+#define SR_CLK 4
+#define HUB75_CLK_PIN 0
+#define HUB75_LAT_PIN 1
+extern volatile GPIO_pin_t *DirectMatrix_SR_PINS;
+#ifndef NO_FASTIO
+extern volatile uint8_t DirectMatrix_HUB75;
+extern volatile GPIO_pin_t *DirectMatrix_HUB75_PINS;
+#endif
+
+static void strobe_pin(GPIO_pin_t pin) {
+    // reversed shift register latches are given negated
+    if (pin > 32768) pin = (GPIO_pin_t) -pin;
+    if (pin == DP_INVALID) return;
+    bank_of(pin)->strobe |= GPIO_PIN_MASK(pin);
+}
+
+// The library starts the timer once its pins are set: the clocks and
+// latches it has are strobes from the first shift out, not only once
+// they have been seen changing twice in a batch, which would let the
+// first clock edge go out with its data.
+static void seed_strobes(void) {
+    if (DirectMatrix_SR_PINS)
+    {
+	strobe_pin(DirectMatrix_SR_PINS[SR_CLK]);
+	for (uint8_t i = 0; i < SR_LATCHES; i++)
+	    strobe_pin(DirectMatrix_SR_PINS[i]);
+    }
+#ifndef NO_FASTIO
+    if (DirectMatrix_HUB75)
+    {
+	strobe_pin(DirectMatrix_HUB75_PINS[HUB75_CLK_PIN]);
+	strobe_pin(DirectMatrix_HUB75_PINS[HUB75_LAT_PIN]);
+    }
+#endif
+}
+
+void linux_timer1_set(uint32_t period_us, void (*isr)(void)) {
+    seed_strobes();
+    pthread_mutex_lock(&timer_lock);
+    timer1.isr = isr;
+    timer1.period = (uint64_t) period_us * 1000;
+    timer1.last = now_ns();
+    timer1.next = timer1.last + timer1.period;
+    timer1.running = 1;
+    if (! timer1.thread) timer1_thread();
+    pthread_cond_signal(&timer_cond);
+    pthread_mutex_unlock(&timer_lock);
+}
+
+// Like changing ICR1: the interval that started at the last overflow
+// gets the new length.
+void linux_timer1_period(uint32_t period_us) {
+    pthread_mutex_lock(&timer_lock);
+    timer1.period = (uint64_t) period_us * 1000;
+    timer1.next = timer1.last + timer1.period;
+    pthread_cond_signal(&timer_cond);
+    pthread_mutex_unlock(&timer_lock);
+}
+
+void linux_timer1_stop(void) {
+    pthread_mutex_lock(&timer_lock);
+    if (timer1.running)
+    {
+	uint64_t now = now_ns();
+	timer1.running = 0;
+	timer1.left = (timer1.next > now) ? timer1.next - now : 0;
+    }
+    pthread_mutex_unlock(&timer_lock);
+}
+
+void linux_timer1_resume(void) {
+    pthread_mutex_lock(&timer_lock);
+    if (! timer1.running && ! released)
+    {
+	timer1.running = 1;
+	timer1.next = now_ns() + timer1.left;
+	timer1.last = timer1.next - timer1.period;
+	pthread_cond_signal(&timer_cond);
+    }
+    pthread_mutex_unlock(&timer_lock);
+}
+
+void linux_timer1_restart(void) {
+    pthread_mutex_lock(&timer_lock);
+    if (! released)
+    {
+	timer1.running = 1;
+	timer1.last = now_ns();
+	timer1.next = timer1.last + timer1.period;
+	pthread_cond_signal(&timer_cond);
+    }
+    pthread_mutex_unlock(&timer_lock);
+}
+
+uint8_t linux_in_isr(void) {
+    return in_isr;
+}
+
+void linux_stats(linux_stats_t *s, uint8_t reset) {
+    pthread_mutex_lock(&timer_lock);
+    *s = stats;
+    s->ioctls = __atomic_load_n(&stats.ioctls, __ATOMIC_RELAXED);
+    if (reset)
+    {
+	uint8_t realtime = stats.realtime;
+	memset(&stats, 0, sizeof(stats));
+	stats.realtime = realtime;
+    }
+    pthread_mutex_unlock(&timer_lock);
+}
+
+// ===========================================================================
+// Arduino core
+// ===========================================================================
+void noInterrupts(void) {
+    if (irq_off) return;
+    pthread_mutex_lock(&irq_lock);
+    irq_off = 1;
+}
+
+void interrupts(void) {
+    if (! irq_off || in_isr) return;
+    irq_off = 0;
+    pthread_mutex_unlock(&irq_lock);
+}
+
+// Stands for the sleep until the next interrupt of DirectMatrix::idle()
+void yield(void) {
+    struct timespec ts = { 0, 100000 };
+
+    nanosleep(&ts, NULL);
+}
+
+unsigned long micros(void) {
+    return (now_ns() - start_ns) / 1000;
+}
+
+unsigned long millis(void) {
+    return (now_ns() - start_ns) / 1000000;
+}
+
+static void sleep_until(uint64_t ns) {
+    struct timespec ts;
+
+    ts.tv_sec = ns / 1000000000;
+    ts.tv_nsec = ns % 1000000000;
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR)
+	;
+}
+
+void delay(unsigned long ms) {
+    sleep_until(now_ns() + (uint64_t) ms * 1000000);
+}
+
+// Short delays spin, they are usually timing a signal
+void delayMicroseconds(unsigned int us) {
+    uint64_t end = now_ns() + (uint64_t) us * 1000;
+
+    if (us >= 100) sleep_until(end);
+    else while (now_ns() < end) ;
+}
+
+long random(long howbig) {
+    if (howbig == 0) return 0;
+    return rand() % howbig;
+}
+
+long random(long howsmall, long howbig) {
+    if (howsmall >= howbig) return howsmall;
+    return random(howbig - howsmall) + howsmall;
+}
+
+void randomSeed(unsigned long seed) {
+    srand(seed);
+}
+
+GPIO_pin_t Arduino_to_GPIO_pin(uint8_t pin) {
+    if (pin < GPIO_PINS_NUMBER) return arduino_pins[pin];
+    return DP_INVALID;
+}
+
+void pinMode2f(GPIO_pin_t pin, uint8_t mode) {
+    bank *b = bank_of(pin);
+    uint8_t mask = GPIO_PIN_MASK(pin);
+
+    if (mode == OUTPUT) bank_setup(b, b->ddr | mask, b->out, mask);
+    else bank_setup(b, b->ddr & ~mask,
+	(mode == INPUT_PULLUP) ? b->out | mask : b->out & ~mask, mask);
+}
+
+void digitalWrite2f(GPIO_pin_t pin, uint8_t value) {
+    bank *b = bank_of(pin);
+    uint8_t mask = GPIO_PIN_MASK(pin);
+
+    bank_set(b, value ? b->out | mask : b->out & ~mask);
+}
+
+uint8_t digitalRead2f(GPIO_pin_t pin) {
+    bank *b = bank_of(pin);
+    uint8_t mask = GPIO_PIN_MASK(pin);
+    gpio_v2_line_values values;
+
+    if (b->ddr & mask) return (b->out & mask) ? HIGH : LOW;
+    if (! (b->used & mask) || released) return LOW;
+    linux_gpio_flush();
+    values.mask = request_bits(b, mask);
+    if (ioctl(b->fd, GPIO_V2_LINE_GET_VALUES_IOCTL, &values) < 0)
+	fail("GPIO_V2_LINE_GET_VALUES_IOCTL");
+    return values.bits ? HIGH : LOW;
+}
+
+void pinMode(uint8_t pin, uint8_t mode) {
+    pinMode2f(Arduino_to_GPIO_pin(pin), mode);
+}
+
+void digitalWrite(uint8_t pin, uint8_t value) {
+    digitalWrite2f(Arduino_to_GPIO_pin(pin), value);
+}
+
+int digitalRead(uint8_t pin) {
+    return digitalRead2f(Arduino_to_GPIO_pin(pin));
+}
+
+size_t HardwareSerial::write(uint8_t c) {
+    return ::write(1, &c, 1);
+}
@@ -0,0 +1,84 @@
+/*
+ * linux_gpio.h
+ *
+ * Linux stand-in for the bits of an Arduino the library uses, on real
+ * GPIO lines: the Uno pins D0-D13, A0-A5 are mapped to the lines of a GPIO
+ * character device (/dev/gpiochipN, v2 uAPI) and the Timer1 interrupt is a
+ * realtime thread. The library, examples and tools compile unmodified
+ * against Arduino.h in this directory, like the extras/host simulator.
+ *
+ * Each Uno port (PORTB/C/D) is one line request, so a GPIO_PORT_REG()
+ * write sets all the lines of the port that change with a single
+ * GPIO_V2_LINE_SET_VALUES ioctl. digitalWrite2f() is one ioctl per call
+ * unless the bank strategy below combines it with its neighbours.
+ *
+ * Environment:
+ *   LEDMATRIX_GPIOCHIP	  chip device, default /dev/gpiochip0
+ *   LEDMATRIX_GPIO_LINES	  line offsets of the pins D0, D1... A5, comma
+ *			  separated, default D0=0 ... A5=19
+ *   LEDMATRIX_GPIO_BATCH	  line or bank, see linux_gpio_batch()
+ *   LEDMATRIX_RT_PRIO	  SCHED_FIFO priority of the timer thread (80),
+ *			  0 for SCHED_OTHER
+ *   LEDMATRIX_CPU		  CPU to pin the timer thread to
+ */
+
+#ifndef LINUX_GPIO_H_
+#define LINUX_GPIO_H_
+
+#include <stdint.h>
+
+// Port register addresses, same as pins2_arduino.h
+#define LINUX_PORTB 0x25
+#define LINUX_PORTC 0x28
+#define LINUX_PORTD 0x2B
+
+// Write strategies of the refresh thread. Outside of it writes always go
+// out immediately.
+//
+// LINUX_GPIO_LINE: one ioctl per write, what the AVR code asks for.
+// LINUX_GPIO_BANK: writes to a bank are combined and go out as one ioctl
+// when the ISR touches another bank, reads, returns, or changes a line of
+// the pending batch again. Strobes (shift register clocks, latches) are
+// always written alone, so that data is set up before the clock edge: the
+// ones given to the library's begin() from the start, and any other line
+// once seen changing twice in a batch.
+#define LINUX_GPIO_LINE 0
+#define LINUX_GPIO_BANK 1
+
+void linux_gpio_batch(uint8_t strategy);
+// Set the lines back to inputs and stop the timer, also done at exit
+void linux_gpio_release(void);
+
+// Write the pending batch, if any
+void linux_gpio_flush(void);
+
+// Whole register access for GPIO_PORT_REG()/GPIO_DDR_REG(), addr is the
+// PORTx address
+uint8_t linux_reg_read(uint8_t addr, uint8_t ddr);
+void linux_reg_write(uint8_t addr, uint8_t ddr, uint8_t value);
+
+// Timer1, driven by the TimerOne stand-in
+void linux_timer1_set(uint32_t period_us, void (*isr)(void));
+void linux_timer1_period(uint32_t period_us);
+void linux_timer1_stop(void);
+void linux_timer1_resume(void);
+void linux_timer1_restart(void);
+uint8_t linux_in_isr(void);
+
+// Timer thread and GPIO statistics since the last reset
+#define LINUX_LATENCY_BINS 1001	// 1us each, the last one is >= 1ms
+typedef struct {
+    uint32_t isr_runs;
+    uint32_t missed;		// periods lost to a late or long ISR
+    uint32_t ioctls;		// GPIO_V2_LINE_SET_VALUES calls
+    uint32_t latency_max;	// ns between the deadline and the ISR start
+    uint64_t latency_sum;
+    uint32_t isr_max;		// ns in the ISR, GPIO writes included
+    uint64_t isr_sum;
+    uint32_t latency[LINUX_LATENCY_BINS];
+    uint8_t realtime;		// the thread got SCHED_FIFO
+} linux_stats_t;
+
+void linux_stats(linux_stats_t *stats, uint8_t reset);
+
+#endif /* LINUX_GPIO_H_ */
@@ -0,0 +1,53 @@
+/*
+ * sketch_main.cpp
+ *
+ * Runs an Arduino sketch on the GPIO lines: setup() then loop() forever
+ * like the Arduino core, on a thread of its own so that Ctrl-C (or -t)
+ * stops it cleanly with the lines back to inputs.
+ *
+ * Usage: run_<example> [-t seconds]
+ */
+
+#include <stdio.h>
+#include <signal.h>
+#include <pthread.h>
+#include <unistd.h>
+#include "Arduino.h"
+
+void setup(void);
+void loop(void);
+
+static void *sketch(void *) {
+    setup();
+    for (;;) loop();
+    return NULL;
+}
+
+int main(int argc, char **argv) {
+    struct timespec timeout = { 0, 0 };
+    pthread_t thread;
+    sigset_t stop;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "t:")) != -1)
+    {
+	if (opt != 't')
+	{
+	    fprintf(stderr, "usage: %s [-t seconds]\n", argv[0]);
+	    return 1;
+	}
+	timeout.tv_sec = atoi(optarg);
+    }
+
+    // Only this thread gets the signals, the sketch and the refresh thread
+    // inherit the mask
+    sigemptyset(&stop);
+    sigaddset(&stop, SIGINT);
+    sigaddset(&stop, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &stop, NULL);
+    pthread_create(&thread, NULL, sketch, NULL);
+    if (timeout.tv_sec) sigtimedwait(&stop, NULL, &timeout);
+    else sigwaitinfo(&stop, NULL);
+    linux_gpio_release();
+    return 0;
+}
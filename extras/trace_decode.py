@@ -0,0 +1,117 @@
+#!/usr/bin/env python3
+"""Decode a DirectMatrix ISR trace dump (see DirectMatrix::traceDump()).
+
+Build the library with DirectMatrix_TRACE set to the number of events to
+keep (LED_Matrix.h), and have your sketch call matrix->traceDump(Serial)
+when you want a dump. Then either capture the serial output to a file:
+    trace_decode.py dump.bin
+or read it straight from the board (needs pyserial):
+    trace_decode.py --port /dev/ttyUSB0 --baud 57600
+
+The timeline shows one line per interrupt: time since the first event,
+time since the previous one, row, BCM plane and ISR runtime. Statistics
+per plane follow.
+"""
+
+import argparse
+import struct
+import sys
+
+MAGIC = b"DMTR"
+HEADER = struct.Struct("<4sBBH")
+EVENT = struct.Struct("<HBBH")
+
+
+def read_dump(stream):
+    """Skip anything before the magic (debug prints...) and parse a dump."""
+    window = b""
+    while window != MAGIC:
+        c = stream.read(1)
+        if not c:
+            raise EOFError("no trace dump found")
+        window = (window + c)[-4:]
+    rest = stream.read(HEADER.size - 4)
+    _, version, size, count = HEADER.unpack(MAGIC + rest)
+    if version != 1 or size != EVENT.size:
+        raise ValueError("unsupported dump version %d / event size %d"
+                         % (version, size))
+    data = stream.read(size * count)
+    if len(data) != size * count:
+        raise EOFError("truncated dump: %d of %d events"
+                       % (len(data) // size, count))
+    events = []
+    now = 0
+    last = None
+    # Timestamps are the low 16 bits of micros(), unwrap them assuming
+    # less than 65ms between two interrupts.
+    for i in range(count):
+        t16, row, plane, runtime = EVENT.unpack_from(data, i * size)
+        if last is not None:
+            now += (t16 - last) & 0xFFFF
+        last = t16
+        events.append((now, row, plane, runtime))
+    return events
+
+
+def timeline(events, out):
+    out.write("%10s %8s %4s %6s %8s\n" % ("time", "delta", "row", "plane",
+                                          "runtime"))
+    prev = None
+    for t, row, plane, runtime in events:
+        delta = "" if prev is None else str(t - prev)
+        prev = t
+        out.write("%10d %8s %4d %6d %8d %s\n" % (t, delta, row, plane,
+                                                 runtime, "#" * (runtime // 4)))
+
+
+def statistics(events, out):
+    if len(events) < 2:
+        out.write("not enough events for statistics\n")
+        return
+    span = events[-1][0] - events[0][0]
+    busy = sum(e[3] for e in events[:-1])
+    out.write("\n%d events over %d us, ISR load %.1f%%\n"
+              % (len(events), span, 100.0 * busy / span if span else 0))
+    out.write("%6s %6s %22s %22s\n" % ("plane", "count", "runtime min/avg/max",
+                                       "period min/avg/max"))
+    # The period of an event is the time until the next interrupt, which is
+    # the slot the row of this event stayed lit for.
+    for plane in sorted(set(e[2] for e in events)):
+        runtimes = [e[3] for e in events if e[2] == plane]
+        periods = [events[i + 1][0] - events[i][0]
+                   for i in range(len(events) - 1) if events[i][2] == plane]
+        line = "%6d %6d %22s" % (plane, len(runtimes), "%d/%.1f/%d" % (
+            min(runtimes), sum(runtimes) / len(runtimes), max(runtimes)))
+        if periods:
+            line += " %22s" % ("%d/%.1f/%d" % (
+                min(periods), sum(periods) / len(periods), max(periods)))
+        out.write(line + "\n")
+    rows = set(e[1] for e in events)
+    out.write("rows seen: %s\n" % " ".join(str(r) for r in sorted(rows)))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("dump", nargs="?", help="binary dump file")
+    parser.add_argument("--port", help="serial port to read the dump from")
+    parser.add_argument("--baud", type=int, default=57600)
+    parser.add_argument("--stats", action="store_true",
+                        help="only print statistics")
+    args = parser.parse_args()
+
+    if args.port:
+        import serial
+        stream = serial.Serial(args.port, args.baud)
+    elif args.dump:
+        stream = open(args.dump, "rb")
+    else:
+        stream = sys.stdin.buffer
+
+    events = read_dump(stream)
+    if not args.stats:
+        timeline(events, sys.stdout)
+    statistics(events, sys.stdout)
+
+
+if __name__ == "__main__":
+    main()